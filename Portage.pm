@@ -6,6 +6,8 @@ package Portage;
 
 use strict;
 use warnings;
+use Storable qw(nstore retrieve);
+use Time::HiRes ();
 
 BEGIN {
     use Exporter ();
@@ -70,14 +72,41 @@ our $used_make_conf = "";
 # uid/gid of the caller, this value is set to 1
 our $ro_mode = 0;
 
+# $vdb_scanner - path of the native vdb scanner (ufed-curses --vdb)
+# If set by the caller before INIT runs, changed categories of /var/db/pkg are
+# read by the scanner in parallel. Otherwise, or if it fails, they are read by
+# _read_vdb_category().
+our $vdb_scanner = "";
+
+# $deferred - If set to 1 by the caller before INIT runs, INIT only reads the
+# configuration, so $used_make_conf and $ro_mode are known. $use_flags is then
+# only generated by calling readUseFlags(). This allows the caller to do other
+# work, like starting its user interface, while the flags are still unknown.
+# Newly parsed flags are then only written to the cache by writeCache(), so
+# the caller can hand them over first.
+our $deferred = 0;
+
+# $eprefix - EPREFIX ufed was built for
+# If set by the caller before INIT runs, it is used unless it does not point
+# to a Portage installation. Otherwise portageq is asked.
+our $eprefix = undef;
+
 # --- private members ---
+my $_cache           = undef; ## Contents of $_cache_file once read. See _read_cache()
+my $_cache_dirty     = 0;  ## 1 if $use_flags were parsed but not written to the cache yet
+my $_cache_file      = ""; ## Set by INIT once EPREFIX is known
+my $_cache_version   = 6;  ## Increase whenever the cache layout changes
 my %_environment     = ();
+my %_expand_groups   = (); ## flag => USE_EXPAND(_HIDDEN) group it was removed for
+my %_manifest        = (); ## path => signature of every parsed input
+my %_profile_files   = (); ## file name => paths in profile order. See _walk_profiles()
 my $_EPREFIX         = "";
 my $_PORTDIR         = "";
 my $_PORTDIR_OVERLAY = "";
 my @_profiles        = ();
 my %_use_eh_safe     = (); ## USE_EXPAND_HIDDEN safe hash. See _read_make_defaults()
 my %_use_order       = ();
+my %_vdb_state       = (); ## category => state of the last vdb scan. See _read_vdb_category()
 
 # $_use_temp - hashref that represents the current state of all known flags.
 # This is for data gathering, the public $use_flags is generated out of this
@@ -113,96 +142,68 @@ my $_use_template = {
 	"package" => 0,
 	pkguse    => 0
 };
-my $_has_eix = 0; # Set to 1 by INIT if eix can be found.
+my $_has_eix = 0; # Set to 1 by _determine_portdir() if eix is needed and found.
 my $_eix_cmd = "";
 
 # --- public methods ---
 sub debugMsg;
+sub readUseFlags;
+sub writeCache;
 
 # --- private methods ---
 sub _add_flag;
 sub _add_temp;
-sub _determine_eprefix_portdir;
+sub _check_used_make_conf;
+sub _determine_eprefix;
 sub _determine_make_conf;
+sub _determine_portdir;
 sub _determine_profiles;
 sub _final_cleaning;
 sub _fix_flags;
 sub _gen_use_flags;
 sub _get_files_from_dir;
+sub _get_line_reader;
+sub _get_signature;
+sub _load_cache;
 sub _merge;
 sub _merge_env;
-sub _noncomments;
 sub _norm_path;
+sub _note_input;
+sub _parse_portage;
+sub _query_portage;
 sub _read_archs;
+sub _read_cache;
+sub _read_configuration;
 sub _read_descriptions;
 sub _read_make_conf;
 sub _read_make_defaults;
 sub _read_make_globals;
 sub _read_package_use;
 sub _read_packages;
+sub _read_repos_conf;
 sub _read_sh;
 sub _read_use_force;
 sub _read_use_mask;
+sub _read_vdb_category;
 sub _remove_expands;
+sub _save_cache;
+sub _scan_vdb;
+sub _use_cached_portdir;
+sub _walk_profiles;
 
 # --- Package initialization ---
 INIT {
 	$_environment{$_} = {} for qw{USE USE_EXPAND USE_EXPAND_HIDDEN};
 	
-	# See if eix is available
-	$_eix_cmd = qx{which eix 2>/dev/null};
-	defined($_eix_cmd)
-        and chomp $_eix_cmd
-        and length($_eix_cmd)
-        and -x $_eix_cmd
-        and $_has_eix = 1
-        and debugMsg("Found eix in \"$_eix_cmd\"")
-         or $_has_eix = 0;
-	
 	# Initialize basics
-	_determine_eprefix_portdir;
-	_determine_make_conf;
-	_determine_profiles;
-	_read_make_globals;
-
-	# make.conf is loaded first to parse for the set overlays
-	# directories, if any. USE flags from make.conf get a
-	# dedicated area {conf}, so there is no harm in loading
-	# it first.
-	_read_make_conf;
+	_determine_eprefix;
+	$_cache_file = "${_EPREFIX}/var/cache/ufed/portage.cache";
 
-	# USE_ORDER must not only be defined, it sets the order in which settings
-	# are loaded overriding each other.
-	defined($_environment{USE_ORDER})
-		or die("Unable to determine USE_ORDER!\nSomething is seriously broken!\n");
-	my $ordNr  = 0;
-	my @use_order = reverse split /:/, $_environment{USE_ORDER};
-	for my $order(@use_order) {
-		"env"         eq $order and next; ## Not used by ufed
-		"pkg"         eq $order and _read_package_use;
-		# "conf" is already loaded
-		"defaults"    eq $order and _read_make_defaults;
-		"pkginternal" eq $order and _read_packages;
-		"repo"        eq $order and next; ## Done in "defaults" and "pkginternal" in the right order
-		"env.d"       eq $order and next; ## Not used by ufed
-		$_use_order{$order} = ++$ordNr;
-	}
-	if ( !defined($_use_order{"defaults"})
-	  || !defined($_use_order{"conf"})
-	  || ($_use_order{"defaults"} > $_use_order{"conf"})) {
-		die("Sorry, USE_ORDER without make.conf overriding global"
-		  . " USE flags are not currently supported by ufed.\n");
-	}
+	# make.conf must always be read to know where changes are to be saved
+	_read_configuration;
 
-	# Now the rest can be read	
-	_read_use_force; ## Must be before _read_use_mask to not
-	_read_use_mask;  ## unintentionally unmask explicitly masked flags.
-	_read_archs;
-	_read_descriptions;
-	_remove_expands;
-	_fix_flags;
-	_final_cleaning;
-	_gen_use_flags;
+	$deferred
+		or readUseFlags;
 }
 
 # --- public methods implementations ---
@@ -219,6 +220,38 @@ sub debugMsg
 	return 1;
 }
 
+
+# Generate $use_flags unless this is already done. This is only needed if
+# $deferred was set, otherwise INIT already did it.
+# No parameters accepted.
+# return: $use_flags
+sub readUseFlags
+{
+	# The full parsing is only needed if the cache is outdated
+	defined($use_flags)
+		or _load_cache
+		or _parse_portage
+		and $_cache_dirty = 1;
+
+	$deferred
+		or writeCache;
+
+	return $use_flags;
+}
+
+
+# Write $use_flags to the cache if readUseFlags() had to parse them. This is
+# only needed if $deferred was set, otherwise readUseFlags() already did it.
+# No parameters accepted.
+sub writeCache
+{
+	$_cache_dirty
+		and _save_cache;
+	$_cache_dirty = 0;
+
+	return;
+}
+
 # --- private methods implementations ---
 
 # Add a flag to $use_flags and intialize it with the given
@@ -298,71 +331,136 @@ sub _add_temp
 }
 
 
-# Determine the values for EPREFIX, PORTDIR and PORTDIR_OVERLAY. These are
-# saved in $_EPREFIX, $_PORTDIR and $_PORTDIR_OVERLAY.
-# This is done using 'eix' with 'portageq' as a fallback.
-# Other output from portageq is printed on STDERR.
+# Tell the user which file is used to store changes and enable the read-only
+# mode if $used_make_conf can not be written to.
 # No parameters accepted.
-sub _determine_eprefix_portdir {
-	my $tmp = "/tmp/ufed_$$.tmp";
+sub _check_used_make_conf {
+	$used_make_conf =~ /\/make\.conf$/
+		or print "Using $used_make_conf as USE flags file\n";
+	debugMsg("$used_make_conf will be used to store changes");
 
-	$_EPREFIX = qx{portageq envvar EPREFIX 2>$tmp};
-	defined($_EPREFIX) and chomp $_EPREFIX or $_EPREFIX="";
-	
-	# Prefer eix over portageq if it is available
-	if ($_has_eix) {
-		debugMsg("Using eix...");
-		
-		local $ENV{PRINT_APPEND}='';
-		$_PORTDIR         = qx{$_eix_cmd --print PORTDIR 2>>$tmp};
-		$_PORTDIR_OVERLAY = qx{$_eix_cmd --print PORTDIR_OVERLAY 2>>$tmp};
-		
-		# eix ends PORTDIR with a slash that must be removed
-		$_PORTDIR =~ s,/+$,,;
-	} else {
-		debugMsg("Using portageq fallback...");
+	# If the make.conf is not writable, enable read-only-mode
+	if (! -w $used_make_conf ) {
+		my $egid = $);
+		$egid =~ s/\s+.*$//; 
+		$ro_mode = 1;
+		print "WARNING: $used_make_conf not writable by uid/gid $>/$egid\n";
+		print "WARNING: ufed will run in read-only-mode!\n";
+	}
+	return;
+}
 
-		my $eroot = qx{portageq envvar EROOT 2>>$tmp};
-		defined($eroot) and chomp $eroot or $eroot="/";
-		
-		# Remove 'gentoo', this is PORTDIR, the others are PORTDIR_OVERLAY.
-		my $repos = join(' ', map {
-			my $x = $_;
-			$x =~ s/^gentoo$//;
-			$x
-		} split(' ', qx{portageq get_repos $eroot 2>>$tmp}) );
-		chomp $repos;
-		
-		# Now the paths can be determined:
-		$_PORTDIR         = qx{portageq get_repo_path $eroot gentoo 2>>$tmp};
-		$_PORTDIR_OVERLAY = join(' ', map {
-			my $x = $_;
-			$x =~ s/^\s*(\S+)\s*$/$1/mg;
-			$x
-		} split('\n', qx{portageq get_repo_path $eroot $repos 2>>$tmp} ));
-		defined($_PORTDIR) and chomp $_PORTDIR;
-		defined($_PORTDIR_OVERLAY) and chomp $_PORTDIR_OVERLAY;
+
+# Determine the value for EPREFIX and save it in $_EPREFIX.
+# PORTAGE_OVERRIDE_EPREFIX from the environment and then $eprefix, as set by
+# the caller, are used if they point to a Portage installation. Only if none
+# of them does, portageq is asked.
+# No parameters accepted.
+sub _determine_eprefix {
+	for my $prefix ($ENV{PORTAGE_OVERRIDE_EPREFIX}, $eprefix) {
+		if ( defined($prefix)
+		  && -r "${prefix}/usr/share/portage/config/make.globals") {
+			$_EPREFIX = $prefix;
+			$_EPREFIX =~ s,/+$,,;
+			debugMsg("EPREFIX='${_EPREFIX}'");
+			return;
+		}
 	}
-	
+
+	debugMsg("Using portageq to determine EPREFIX...");
+	$_EPREFIX = _query_portage("portageq envvar EPREFIX");
 	debugMsg("EPREFIX='${_EPREFIX}'");
-	debugMsg("PORTDIR='${_PORTDIR}'");
-	debugMsg("PORTDIR_OVERLAY='${_PORTDIR_OVERLAY}'");
 
-	# Print error messages if any:
-	if ( -s $tmp ) {
-		if (open (my $fTmp, "<", $tmp)) {
-			print STDERR "$_" while (<$fTmp>);
-			close $fTmp;
+	return;
+}
+
+
+# Determine the values for PORTDIR and PORTDIR_OVERLAY. These are saved in
+# $_PORTDIR and $_PORTDIR_OVERLAY.
+# The repositories are taken from repos.conf, and PORTDIR and
+# PORTDIR_OVERLAY from make.globals and make.conf override and extend them.
+# Only if this does not lead to a usable PORTDIR, the values of the cache are
+# used if the configuration read so far did not change since it was written.
+# Otherwise this is done using 'eix' with 'portageq' as a fallback.
+# No parameters accepted.
+sub _determine_portdir {
+	my %repos    = _read_repos_conf;
+	my $main     = $repos{DEFAULT}{"main-repo"} || "gentoo";
+	my @overlays = map { $repos{$_}{location} } sort {
+			($repos{$a}{priority} || 0) <=> ($repos{$b}{priority} || 0)
+			|| $a cmp $b
+		} grep {
+			("DEFAULT" ne $_)
+			&& ($main ne $_)
+			&& defined($repos{$_}{location})
+		} keys %repos;
+
+	$_PORTDIR = $repos{$main}{location} || "";
+
+	# Old style settings still win
+	defined($_environment{PORTDIR})
+		and length($_environment{PORTDIR})
+		and $_PORTDIR = $_environment{PORTDIR};
+	if (defined($_environment{PORTDIR_OVERLAY})) {
+		for my $overlay (split(' ', $_environment{PORTDIR_OVERLAY})) {
+			grep { $overlay eq $_ } @overlays
+				or push @overlays, $overlay;
 		}
 	}
-	-e $tmp and unlink $tmp;
+	$_PORTDIR =~ s,/+$,,;
+	$_PORTDIR_OVERLAY = join(' ', @overlays);
+
+	if ( ( !length($_PORTDIR) || ! -d "${_PORTDIR}/profiles" )
+	  && !_use_cached_portdir ) {
+		# See if eix is available
+		$_eix_cmd = qx{which eix 2>/dev/null};
+		defined($_eix_cmd)
+			and chomp $_eix_cmd
+			and length($_eix_cmd)
+			and -x $_eix_cmd
+			and $_has_eix = 1
+			and debugMsg("Found eix in \"$_eix_cmd\"")
+			 or $_has_eix = 0;
+
+		# Prefer eix over portageq if it is available
+		if ($_has_eix) {
+			debugMsg("Using eix...");
+			
+			local $ENV{PRINT_APPEND}='';
+			$_PORTDIR         = _query_portage("$_eix_cmd --print PORTDIR");
+			$_PORTDIR_OVERLAY = _query_portage("$_eix_cmd --print PORTDIR_OVERLAY");
+			
+			# eix ends PORTDIR with a slash that must be removed
+			$_PORTDIR =~ s,/+$,,;
+		} else {
+			debugMsg("Using portageq fallback...");
+
+			my $eroot = _query_portage("portageq envvar EROOT");
+			length($eroot) or $eroot = "/";
+			
+			# Remove 'gentoo', this is PORTDIR, the others are PORTDIR_OVERLAY.
+			my $repos = join(' ', map {
+				my $x = $_;
+				$x =~ s/^gentoo$//;
+				$x
+			} split(' ', _query_portage("portageq get_repos $eroot")) );
+			
+			# Now the paths can be determined:
+			$_PORTDIR         = _query_portage("portageq get_repo_path $eroot gentoo");
+			$_PORTDIR_OVERLAY = join(' ', map {
+				my $x = $_;
+				$x =~ s/^\s*(\S+)\s*$/$1/mg;
+				$x
+			} split('\n', _query_portage("portageq get_repo_path $eroot $repos") ));
+		}
+	}
+	
+	debugMsg("PORTDIR='${_PORTDIR}'");
+	debugMsg("PORTDIR_OVERLAY='${_PORTDIR_OVERLAY}'");
 
 	# Die unless this is sane
-	defined($_EPREFIX)
-		and defined($_PORTDIR)
-		and length($_PORTDIR)
-		and defined($_PORTDIR_OVERLAY)
-		 or die "\nCouldn't determine EPREFIX and PORTDIR from Portage\n";
+	length($_PORTDIR)
+		or die "\nCouldn't determine PORTDIR from Portage\n";
 
 	return;
 }
@@ -396,7 +494,9 @@ sub _determine_make_conf
 sub _determine_profiles
 {
 	my $mp_path = "${_EPREFIX}/etc/portage/make.profile";
+	_note_input($mp_path);
 	-e $mp_path or $mp_path = "${_EPREFIX}/etc/make.profile";
+	_note_input($mp_path);
 	
 	-e $mp_path
 		or die("make.profile can not be found");
@@ -417,9 +517,9 @@ sub _determine_profiles
 	# Start with the found path, it is the deepest profile child.
 	@_profiles = -l $mp_path ? _norm_path('/etc', $mp) : $mp;
 	for (my $i = -1; $i >= -@_profiles; $i--) {
-		for(_noncomments("${_profiles[$i]}/parent")) {
-			length($_)
-				and splice(@_profiles, $i, 0, _norm_path(${_profiles[$i]}, $_));
+		my $next = _get_line_reader("${_profiles[$i]}/parent");
+		while (defined(my $parent = $next->())) {
+			splice(@_profiles, $i, 0, _norm_path(${_profiles[$i]}, $parent));
 		}
 	}
 	return;
@@ -634,6 +734,9 @@ sub _get_files_from_dir {
 	 
 	defined($isRecursive) or $isRecursive = 0;
 
+	# New or removed files change the directory signature
+	_note_input($search_path);
+
 	for my $confFile (glob("$search_path/*")) {
 		
 		# Skip hidden and backup files
@@ -670,6 +773,98 @@ sub _get_files_from_dir {
 }
 
 
+# Create an iterator over all lines of a given file/dir that are no pure
+# comments. Comments and trailing blanks are stripped and empty lines are
+# skipped. Files are read line by line, and the files of a directory one
+# after the other, so memory usage does not depend on the file sizes.
+# Parameter 1: filename/dirname
+# return: code reference that returns the next line or undef at the end.
+sub _get_line_reader {
+	my ($fname) = @_;
+	my @files   = ($fname);
+	my $file    = undef;
+
+	_note_input($fname);
+	-d $fname
+		and @files = grep { -f $_ } _get_files_from_dir($fname);
+
+	return sub {
+		for (;;) {
+			if (!defined($file)) {
+				@files or return;
+				my $next = shift @files;
+				_note_input($next);
+				open($file, '<', $next)
+					or $file = undef
+					or next;
+				binmode( $file, ":encoding(UTF-8)" );
+			}
+			while (my $line = <$file>) {
+				$line =~ s/\s*(?:#.*)?$//s;
+				length($line) and return $line;
+			}
+			close $file;
+			$file = undef;
+		}
+	};
+}
+
+
+# Generate a signature of inode, size, mtime and ctime of a path. The times
+# are taken with sub-second precision, so an edit keeping the size within the
+# second the cache was written is noticed, too. Symlinks get the signature of
+# their target appended, so retargeting make.profile or replacing the target
+# is noticed.
+# Parameter 1: the path to examine
+# return: the signature string or "-" if the path does not exist.
+sub _get_signature {
+	my ($path) = @_;
+	my @st = Time::HiRes::lstat($path)
+		or return "-";
+	my $sig = join(':', @st[1,7,9,10]);
+
+	if (-l _) {
+		my @tgt = Time::HiRes::stat($path);
+		$sig .= ">" . (@tgt ? join(':', @tgt[1,7,9,10]) : "-");
+	}
+
+	return $sig;
+}
+
+
+# Load $use_flags from $_cache_file if the cache exists
+# and none of the paths in its manifest have changed since it was written.
+# No parameters accepted.
+# return: 1 if the cache was used, 0 otherwise.
+sub _load_cache {
+	my $cache = _read_cache
+		or return 0;
+
+	# Even if the cache is outdated, the state of the last vdb scan
+	# allows to only re-read packages that changed since then.
+	"HASH" eq ref($cache->{vdb})
+		and %_vdb_state = %{$cache->{vdb}};
+
+	# The repositories might be reported by eix or portageq only
+	( ($_EPREFIX         eq $cache->{eprefix})
+	  && ($_PORTDIR         eq $cache->{portdir})
+	  && ($_PORTDIR_OVERLAY eq $cache->{overlay}) )
+		or debugMsg("Cache outdated by the repositories")
+		and return 0;
+
+	for my $path (keys %{$cache->{manifest}}) {
+		_get_signature($path) eq $cache->{manifest}{$path}
+			or debugMsg("Cache outdated by $path")
+			and return 0;
+	}
+
+	$use_flags = $cache->{use_flags};
+	debugMsg("Using cache $_cache_file");
+
+	return 1;
+}
+
+
 # merges two hashes into the first.
 # Parameter 1: reference of the destination hash
 # Parameter 2: reference of the source hash
@@ -709,32 +904,6 @@ sub _merge_env {
 }
 
 
-# returns a list of all lines of a given file/dir
-# that are no pure comments
-# Parameter 1: filename/dirname
-sub _noncomments {
-	my ($fname) = @_;
-	my @result  = ();
-
-	if(-d $fname) {
-		for my $i (_get_files_from_dir($fname)) {
-			(-f $i) && push @result, _noncomments($i);
-		}
-	} else {
-		local $/;
-		if(open my $file, '<', $fname) {
-			binmode( $file, ":encoding(UTF-8)" );
-			my $content = <$file> || "";
-			close $file;
-			@result = split /(?:[^\S\n]*(?:#.*)?\n)+/, "$content\n";
-			shift @result while ( (@result > 0) && !length($result[0]) );
-		}
-	}
-
-	return @result;
-}
-
-
 # normalizes a given path behind a base
 # Parameter 1: base path 
 # Parameter 2: sub path
@@ -761,13 +930,94 @@ sub _norm_path {
 }
 
 
+# Record the current signature of a path that is used to gather the flag
+# data, so _load_cache can determine whether a later run can use the cache.
+# Parameter 1: the path to record
+sub _note_input {
+	my ($path) = @_;
+	$_manifest{$path} = _get_signature($path);
+	return;
+}
+
+
+# Parse all profiles and installed packages and generate $use_flags out of
+# them. The configuration must have been read by _read_configuration().
+# No parameters accepted.
+# return: 1, any error is fatal.
+sub _parse_portage {
+	# /etc/portage is recorded as well, so newly added files that were not
+	# there to be parsed invalidate the cache. (Profiles: see _walk_profiles)
+	_note_input($_) for ("${_EPREFIX}/etc/portage", $INC{"Portage.pm"});
+
+	_walk_profiles;
+
+	# USE_ORDER must not only be defined, it sets the order in which settings
+	# are loaded overriding each other.
+	defined($_environment{USE_ORDER})
+		or die("Unable to determine USE_ORDER!\nSomething is seriously broken!\n");
+	my $ordNr  = 0;
+	my @use_order = reverse split /:/, $_environment{USE_ORDER};
+	for my $order(@use_order) {
+		"env"         eq $order and next; ## Not used by ufed
+		"pkg"         eq $order and _read_package_use;
+		# "conf" is already loaded
+		"defaults"    eq $order and _read_make_defaults;
+		"pkginternal" eq $order and _read_packages;
+		"repo"        eq $order and next; ## Done in "defaults" and "pkginternal" in the right order
+		"env.d"       eq $order and next; ## Not used by ufed
+		$_use_order{$order} = ++$ordNr;
+	}
+	if ( !defined($_use_order{"defaults"})
+	  || !defined($_use_order{"conf"})
+	  || ($_use_order{"defaults"} > $_use_order{"conf"})) {
+		die("Sorry, USE_ORDER without make.conf overriding global"
+		  . " USE flags are not currently supported by ufed.\n");
+	}
+
+	# Now the rest can be read	
+	_read_use_force; ## Must be before _read_use_mask to not
+	_read_use_mask;  ## unintentionally unmask explicitly masked flags.
+	_read_archs;
+	_read_descriptions;
+	_remove_expands;
+	_fix_flags;
+	_final_cleaning;
+	_gen_use_flags;
+
+	return 1;
+}
+
+
+# Run a portageq or eix command and return its output. Messages the command
+# writes on STDERR are printed on STDERR after it finished.
+# Parameter 1: the command line to run
+# return: the output without the trailing newline, "" if there is none.
+sub _query_portage {
+	my ($cmd)  = @_;
+	my $tmp    = "/tmp/ufed_$$.tmp";
+	my $result = qx{$cmd 2>$tmp};
+	defined($result) and chomp $result or $result = "";
+
+	# Print error messages if any:
+	if ( -s $tmp ) {
+		if (open (my $fTmp, "<", $tmp)) {
+			print STDERR "$_" while (<$fTmp>);
+			close $fTmp;
+		}
+	}
+	-e $tmp and unlink $tmp;
+
+	return $result;
+}
+
+
 # reads all found arch.list and erase all found archs from $_use_temp. Archs
 # are not setable.
 # No parameters accepted
 sub _read_archs {
-	for my $dir(@_profiles) {
-		next unless (-r "$dir/arch.list");
-		for my $arch (_noncomments("$dir/arch.list")) {
+	for my $file (@{$_profile_files{"arch.list"}}) {
+		my $next = _get_line_reader($file);
+		while (defined(my $arch = $next->())) {
 			length($arch)
 				and defined($_use_temp->{$arch})
 				and delete($_use_temp->{$arch});
@@ -777,33 +1027,73 @@ sub _read_archs {
 }
 
 
+# Read $_cache_file once and keep its contents in $_cache.
+# No parameters accepted.
+# return: the cache hashref, or undef if there is no usable cache.
+sub _read_cache {
+	if (!defined($_cache)) {
+		$_cache = {};
+		if (-r $_cache_file) {
+			my $cache = eval { retrieve($_cache_file) };
+			( defined($cache)
+			  && ("HASH" eq ref($cache))
+			  && defined($cache->{version})
+			  && ($_cache_version == $cache->{version}) )
+				and $_cache = $cache
+				 or debugMsg("Cache $_cache_file is unusable");
+		}
+	}
+
+	return %{$_cache} ? $_cache : undef;
+}
+
+
+# Read make.globals and make.conf to determine $used_make_conf, $ro_mode and
+# the profiles and repositories to parse. This is cheap and done by INIT even
+# if $use_flags can later be loaded from the cache.
+# No parameters accepted.
+sub _read_configuration {
+	_determine_make_conf;
+	_determine_profiles;
+	_read_make_globals;
+
+	# make.conf is loaded first to parse for the set overlays
+	# directories, if any. USE flags from make.conf get a
+	# dedicated area {conf}, so there is no harm in loading
+	# it first.
+	_read_make_conf;
+
+	return;
+}
+
+
 # reads all use.desc and use.local.desc and updates $_use_temp accordingly.
 # No parameters accepted
 sub _read_descriptions
 {
-	for my $dir(@_profiles) {
-		if (-r "$dir/use.desc") {
-			for(_noncomments("$dir/use.desc")) {
-				my ($flag, $desc) = /^(.*?)\s+-\s+(.*)$/ or next;
-				
-				_add_temp($flag, "global");
+	for my $file (@{$_profile_files{"use.desc"}}) {
+		my $next = _get_line_reader($file);
+		while (defined(my $line = $next->())) {
+			my ($flag, $desc) = $line =~ /^(.*?)\s+-\s+(.*)$/ or next;
+			
+			_add_temp($flag, "global");
 
-				$_use_temp->{$flag}{global}{descr} = $desc;
-			}
-		} ## End of having a use.desc file
+			$_use_temp->{$flag}{global}{descr} = $desc;
+		}
+	} ## End of looping use.desc files
 
-		if (-r "$dir/use.local.desc") {
-			for(_noncomments("$dir/use.local.desc")) {
-				my ($pkg, $flag, $desc) = /^(.*?):(.*?)\s+-\s+(.*)$/ or next;
+	for my $file (@{$_profile_files{"use.local.desc"}}) {
+		my $next = _get_line_reader($file);
+		while (defined(my $line = $next->())) {
+			my ($pkg, $flag, $desc) = $line =~ /^(.*?):(.*?)\s+-\s+(.*)$/ or next;
 
-				# Here we do not explicitly add a {global} part,
-				# some flags are local only.
-				_add_temp($flag, $pkg);
-				
-				$_use_temp->{$flag}{"local"}{$pkg}{descr} = $desc;
-			}
-		} ## End of having a use.local.desc file
-	} ## End of looping the profiles
+			# Here we do not explicitly add a {global} part,
+			# some flags are local only.
+			_add_temp($flag, $pkg);
+			
+			$_use_temp->{$flag}{"local"}{$pkg}{descr} = $desc;
+		}
+	} ## End of looping use.local.desc files
 	return;
 }
 
@@ -841,21 +1131,9 @@ sub _read_make_conf {
 	}
 	
 	# If there is no used make.conf found, yet, save it:
-	if ( 0 == length($used_make_conf) ) {
-		$used_make_conf = $lastUSEFile;
-		$used_make_conf =~ /\/make\.conf$/
-			or print "Using $used_make_conf as USE flags file\n";
-	}
-	debugMsg("$used_make_conf will be used to store changes");
-
-	# If the make.conf is not writable, enable read-only-mode
-	if (! -w $used_make_conf ) {
-		my $egid = $);
-		$egid =~ s/\s+.*$//; 
-		$ro_mode = 1;
-		print "WARNING: $used_make_conf not writable by uid/gid $>/$egid\n";
-		print "WARNING: ufed will run in read-only-mode!\n";
-	}
+	0 == length($used_make_conf)
+		and $used_make_conf = $lastUSEFile;
+	_check_used_make_conf;
 
 	# Note the conf state of the read flags:
 	for my $flag ( keys %{$oldEnv{USE}}) {
@@ -869,6 +1147,7 @@ sub _read_make_conf {
 	}
 	
 	# Add PORTDIR and overlays to @_profiles
+	_determine_portdir;
 	length ($_PORTDIR)
 		and push @_profiles, "${_PORTDIR}/profiles"
 		or  die("Unable to determine PORTDIR!\nSomething is seriously broken here!\n");
@@ -889,25 +1168,23 @@ sub _read_make_conf {
 sub _read_make_defaults {
 
 	# make.defaults are parsed first by portage:
-	for my $dir(@_profiles) {
-		if (-r "$dir/make.defaults") {
-			my %env = _read_sh("$dir/make.defaults");
-	
-			# Note the conf state of the read flags:
-			for my $flag ( keys %{$env{USE}}) {
-				_add_temp($flag, "global");
+	for my $file (@{$_profile_files{"make.defaults"}}) {
+		my %env = _read_sh($file);
 
-				$env{USE}{$flag}
-					and $_use_temp->{$flag}{global}{"default"} = 1
-					or  $_use_temp->{$flag}{global}{"default"} = -1;
-			}
-			
-			# Safe USE_EXPAND_HIDDEN if set. This is done because a user might
-			# set it to "-*" in make.conf, which does not disable flags but only
-			# the hidden status making them visible.
-			_merge(\%_use_eh_safe, $env{USE_EXPAND_HIDDEN})
-				if (defined($env{USE_EXPAND_HIDDEN}));
+		# Note the conf state of the read flags:
+		for my $flag ( keys %{$env{USE}}) {
+			_add_temp($flag, "global");
+
+			$env{USE}{$flag}
+				and $_use_temp->{$flag}{global}{"default"} = 1
+				or  $_use_temp->{$flag}{global}{"default"} = -1;
 		}
+		
+		# Safe USE_EXPAND_HIDDEN if set. This is done because a user might
+		# set it to "-*" in make.conf, which does not disable flags but only
+		# the hidden status making them visible.
+		_merge(\%_use_eh_safe, $env{USE_EXPAND_HIDDEN})
+			if (defined($env{USE_EXPAND_HIDDEN}));
 	} ## End of reading make.defaults
 
 	return;
@@ -930,10 +1207,11 @@ sub _read_make_globals {
 # No parameters accepted.
 sub _read_package_use
 {
-	for my $dir(@_profiles, "${_EPREFIX}/etc/portage") {
-		my $tgt = $dir eq "${_EPREFIX}/etc/portage" ? "pkguse" : "package";
-		for(_noncomments("$dir/package.use") ) {
-			my($pkg, @flags) = split;
+	for my $file (@{$_profile_files{"package.use"}}, "${_EPREFIX}/etc/portage/package.use") {
+		my $tgt = $file eq "${_EPREFIX}/etc/portage/package.use" ? "pkguse" : "package";
+		my $next = _get_line_reader($file);
+		while (defined(my $line = $next->())) {
+			my($pkg, @flags) = split(' ', $line);
 			
 			for my $flag (@flags) {
 				my $state = $flag =~ s/^-// || 0;
@@ -957,30 +1235,38 @@ sub _read_package_use
 # Analyze EPREFIX/var/db/pkg and analyze all installed packages. The contents
 # of the file IUSE are used to enrich the information of the {default} part and
 # to determine which packages are installed.
+# Only categories and packages that changed since the last scan recorded in
+# %_vdb_state are actually read, see _read_vdb_category().
 sub _read_packages {
 	my $pkgdir = undef;
+	my %vdb    = ();
 	opendir($pkgdir, "${_EPREFIX}/var/db/pkg")
 		or die "Couldn't read ${_EPREFIX}/var/db/pkg\n";
-		
+	_note_input("${_EPREFIX}/var/db/pkg");
+	my @cats = grep { $_ ne '.' and $_ ne '..' } readdir $pkgdir;
+	closedir $pkgdir;
+
+	# Let the native scanner read all changed categories at once
+	my @changed = grep {
+		!defined($_vdb_state{$_})
+		or ($_vdb_state{$_}{sig} ne _get_signature("${_EPREFIX}/var/db/pkg/$_"))
+	} @cats;
+	debugMsg(scalar(@changed) . " of " . scalar(@cats) . " categories changed since the last scan");
+	%vdb = _scan_vdb(@changed);
+
 	# loop through all categories in pkgdir
-	while(my $cat = readdir $pkgdir) {
-		next if $cat eq '.' or $cat eq '..';
-		my $catdir = undef;
-		opendir($catdir, "${_EPREFIX}/var/db/pkg/$cat")
+	for my $cat (@cats) {
+
+		# Installing or removing a package changes the category directory
+		_note_input("${_EPREFIX}/var/db/pkg/$cat");
+		defined($vdb{$cat})
+			or $vdb{$cat} = _read_vdb_category($cat)
+			or delete($vdb{$cat})
 			or next;
 
-		# loop through all openable directories in cat
-		while(my $pkg = readdir $catdir) {
-			next if $pkg eq '.' or $pkg eq '..';
-			my @iuse = ();
-			
-			# Load IUSE to learn which use flags the package in this version knows
-			my $fiuse = "${_EPREFIX}/var/db/pkg/$cat/$pkg/IUSE";
-			if(open my $use, '<', $fiuse) {
-				local $/;
-				@iuse = split ' ', <$use>;
-				close $use;
-			}
+		# loop through all known packages in cat
+		for my $pkg (sort keys %{$vdb{$cat}{pkgs}}) {
+			my @iuse = @{$vdb{$cat}{pkgs}{$pkg}{iuse}};
 
 			# could be shortened, but make sure not to strip off part of the name
 			$pkg =~ s/-\d+(?:\.\d+)*\w?(?:_(?:alpha|beta|pre|rc|p)\d*)*(?:-r\d+)?$//;
@@ -1000,13 +1286,38 @@ sub _read_packages {
 			} ## End of looping IUSE
 			
 		}
-		closedir $catdir;
 	}
-	closedir $pkgdir;
+
+	# Categories no longer found are dropped with this:
+	%_vdb_state = %vdb;
 	return;
 }
 
 
+# read repos.conf from the Portage defaults and /etc/portage, which can be a
+# file or a directory, into a hash. Later settings override earlier ones.
+# No parameters accepted.
+# return: hash of section => { key => value }
+sub _read_repos_conf {
+	my %repos = ();
+
+	for my $conf ("${_EPREFIX}/usr/share/portage/config/repos.conf",
+	              "${_EPREFIX}/etc/portage/repos.conf") {
+		my $section = "DEFAULT";
+		my $next    = _get_line_reader($conf);
+		while (defined(my $line = $next->())) {
+			if ($line =~ /^\s*\[\s*(.+?)\s*\]\s*$/) {
+				$section = $1;
+			} elsif ($line =~ /^\s*([^=\s]+)\s*=\s*(.*?)\s*$/) {
+				$repos{$section}{$1} = $2;
+			}
+		}
+	}
+
+	return %repos;
+}
+
+
 # reads the given file and parses it for key=value pairs.
 # "source" entries are added to the file and parsed as well. The results of the
 # parsing are merged into %environment.
@@ -1033,6 +1344,7 @@ sub _read_sh {
 	)"}sx;                                     # doublequoted value
 
 	my %env;
+	_note_input($fname);
 	if(open my $file, '<', $fname) {
 		{ local $/; $_ = <$file> }
 		close $file;
@@ -1071,6 +1383,7 @@ sub _read_sh {
 					}
 				}
 				if($name eq 'source') {
+					_note_input($value);
 					open my $f, '<', $value or die "Unable to open $value\n$!\n";
 					my $pos = pos;
 					substr($_, pos, 0) = do {
@@ -1099,40 +1412,40 @@ sub _read_sh {
 # Save the found masks in %use_flags.
 # No parameters accepted.
 sub _read_use_force {
-	for my $dir(@_profiles) {
-		if (-r "$dir/use.force") {
-			# use.force can enforce and mask specific flags
-			for my $flag (_noncomments("$dir/use.force") ) {
+	# use.force can enforce and mask specific flags
+	for my $file (@{$_profile_files{"use.force"}}) {
+		my $next = _get_line_reader($file);
+		while (defined(my $flag = $next->())) {
+			my $state = $flag =~ s/^-// || 0;
+			
+			_add_temp($flag, "global");
+
+			$_use_temp->{$flag}{global}{masked} = !$state;
+			$_use_temp->{$flag}{global}{forced} = !$state;
+		}
+	} ## End of looping use.force files
+	
+	# package.use.force can enforce or unforce flags per package
+	for my $file (@{$_profile_files{"package.use.force"}}) {
+		my $next = _get_line_reader($file);
+		while (defined(my $line = $next->())) {
+			my($pkg, @flags) = split(' ', $line);
+			for my $flag (@flags) {
 				my $state = $flag =~ s/^-// || 0;
-				
+
 				_add_temp($flag, "global");
-	
-				$_use_temp->{$flag}{global}{masked} = !$state;
-				$_use_temp->{$flag}{global}{forced} = !$state;
-			}
-		} ## End of having a use.force file
-		
-		if (-r "$dir/package.use.force") {
-			# package.use.force can enforce or unforce flags per package
-			for(_noncomments("$dir/package.use.force") ) {
-				my($pkg, @flags) = split;
-				for my $flag (@flags) {
-					my $state = $flag =~ s/^-// || 0;
-	
-					_add_temp($flag, "global");
-					_add_temp($flag, $pkg);
-	
-					if ($state) {
-						$_use_temp->{$flag}{"local"}{$pkg}{masked} = -1; ## explicitly unmasked and
-						$_use_temp->{$flag}{"local"}{$pkg}{forced} = -1; ## explicitly unforced
-					} else {
-						$_use_temp->{$flag}{"local"}{$pkg}{masked} =  1; ## explicitly masked and
-						$_use_temp->{$flag}{"local"}{$pkg}{forced} =  1; ## explicitly enforced
-					}
+				_add_temp($flag, $pkg);
+
+				if ($state) {
+					$_use_temp->{$flag}{"local"}{$pkg}{masked} = -1; ## explicitly unmasked and
+					$_use_temp->{$flag}{"local"}{$pkg}{forced} = -1; ## explicitly unforced
+				} else {
+					$_use_temp->{$flag}{"local"}{$pkg}{masked} =  1; ## explicitly masked and
+					$_use_temp->{$flag}{"local"}{$pkg}{forced} =  1; ## explicitly enforced
 				}
 			}
-		} ## End of having a package.use.force file
-	} ## End of looping through the profiles
+		}
+	} ## End of looping package.use.force files
 	return;
 }
 
@@ -1141,38 +1454,90 @@ sub _read_use_force {
 # Save the found masks in %use_flags.
 # No parameters accepted.
 sub _read_use_mask {
-	for my $dir(@_profiles) {
-		if (-r "$dir/use.mask") {
-			# use.mask can enable or disable masks
-			for my $flag (_noncomments("$dir/use.mask") ) {
+	# use.mask can enable or disable masks
+	for my $file (@{$_profile_files{"use.mask"}}) {
+		my $next = _get_line_reader($file);
+		while (defined(my $flag = $next->())) {
+			my $state = $flag =~ s/^-// || 0;
+
+			_add_temp($flag, "global");
+
+			$_use_temp->{$flag}{global}{masked} = !$state;
+		}
+	} ## End of looping use.mask files
+	
+	# package.use.mask can enable or disable masks per package
+	for my $file (@{$_profile_files{"package.use.mask"}}) {
+		my $next = _get_line_reader($file);
+		while (defined(my $line = $next->())) {
+			my($pkg, @flags) = split(' ', $line);
+			for my $flag (@flags) {
 				my $state = $flag =~ s/^-// || 0;
 
 				_add_temp($flag, "global");
-	
-				$_use_temp->{$flag}{global}{masked} = !$state;
-			}
-		} ## End of having a use.mask file
-		
-		if (-r "$dir/package.use.mask") {
-		# package.use.mask can enable or disable masks per package
-			for(_noncomments("$dir/package.use.mask") ) {
-				my($pkg, @flags) = split;
-				for my $flag (@flags) {
-					my $state = $flag =~ s/^-// || 0;
-	
-					_add_temp($flag, "global");
-					_add_temp($flag, $pkg);
-	
-					$state and $_use_temp->{$flag}{"local"}{$pkg}{masked} = -1; ## explicitly unmasked
-					$state  or $_use_temp->{$flag}{"local"}{$pkg}{masked} =  1; ## explicitly masked
-				}
+				_add_temp($flag, $pkg);
+
+				$state and $_use_temp->{$flag}{"local"}{$pkg}{masked} = -1; ## explicitly unmasked
+				$state  or $_use_temp->{$flag}{"local"}{$pkg}{masked} =  1; ## explicitly masked
 			}
-		} ## End of having a package.use.mask file
-	} ## End of looping through the profiles
+		}
+	} ## End of looping package.use.mask files
 	return;
 }
 
 
+# Determine the IUSE of all packages installed in one category. Packages are
+# only read if their directory signature differs from the last scan, and the
+# whole category is skipped if its own signature did not change.
+# Parameter 1: the category to examine
+# return: hashref with the state of the category, undef if it can't be read.
+# Layout of the state:
+# {sig}               = signature of the category directory
+# {pkgs}->{pkg-ver}   = hashref for each installed package version
+#   ->{sig}           = signature of the package directory
+#   ->{iuse}          = arrayref of the words in IUSE
+sub _read_vdb_category {
+	my ($cat)   = @_;
+	my $catpath = "${_EPREFIX}/var/db/pkg/$cat";
+	my $old     = $_vdb_state{$cat};
+	my $state   = { sig => _get_signature($catpath), pkgs => {} };
+
+	defined($old)
+		and ($old->{sig} eq $state->{sig})
+		and return $old;
+
+	my $catdir = undef;
+	opendir($catdir, $catpath)
+		or return;
+
+	# loop through all openable directories in cat
+	while(my $pkg = readdir $catdir) {
+		next if $pkg eq '.' or $pkg eq '..';
+		my $sig  = _get_signature("$catpath/$pkg");
+		my @iuse = ();
+
+		if ( defined($old)
+		  && defined($old->{pkgs}{$pkg})
+		  && ($old->{pkgs}{$pkg}{sig} eq $sig) ) {
+			$state->{pkgs}{$pkg} = $old->{pkgs}{$pkg};
+			next;
+		}
+
+		# Load IUSE to learn which use flags the package in this version knows
+		debugMsg("Reading $catpath/$pkg");
+		if(open my $use, '<', "$catpath/$pkg/IUSE") {
+			local $/;
+			@iuse = split ' ', <$use>;
+			close $use;
+		}
+		$state->{pkgs}{$pkg} = { sig => $sig, iuse => [ @iuse ] };
+	}
+	closedir $catdir;
+
+	return $state;
+}
+
+
 # TODO : Remove this function once the usage of the USE_EXPAND
 #        values is implemented.
 # For now all use flags that are expanded are removed. They are not
@@ -1197,6 +1562,8 @@ sub _read_use_mask {
 #
 # Note3: It can happen, that a user sets USE_EXPAND_HIDDEN to "-*" - which then moves
 #        all entries to MOVE_EXPAND making them visible.
+#
+# The group each removed flag belonged to is noted in %_expand_groups.
 sub _remove_expands {
 
 	my $expands = $_environment{USE_EXPAND} || {};
@@ -1209,21 +1576,153 @@ sub _remove_expands {
 		$hidden = {};
 	}
 
-	for my $key (map {my $x=lc($_)."_"; $x } keys %$expands) {
-		for my $flag (keys %$_use_temp) {
-			if ($flag =~ /^$key/ ) {
-				delete($_use_temp->{$flag});
-			} 
+	# Map each flag prefix to its group and combine all of them into one
+	# pattern. Longer prefixes go first, so the most specific group wins.
+	my %prefixes = map { lc($_) . "_" => $_ } (keys %$expands, keys %$hidden);
+	%prefixes or return;
+	my $prefix_re = join('|', map { quotemeta }
+		sort { length($b) <=> length($a) || $a cmp $b } keys %prefixes);
+	$prefix_re = qr/^($prefix_re)/;
+
+	for my $flag (keys %$_use_temp) {
+		if ($flag =~ $prefix_re) {
+			$_expand_groups{$flag} = $prefixes{$1};
+			delete($_use_temp->{$flag});
 		}
-	} ## Done looping USE_EXPAND
+	} ## Done looping flags
+
+	return;
+}
+
+
+# Write $use_flags together with the manifest of all parsed paths into
+# $_cache_file. Failing to write the cache is not fatal.
+# No parameters accepted.
+sub _save_cache {
+	my $cache_dir = $_cache_file;
+	$cache_dir =~ s,/[^/]+$,,;
+	-d $cache_dir
+		or mkdir($cache_dir, 0755)
+		or debugMsg("Unable to create $cache_dir: $!")
+		and return;
+
+	my $tmp = "${_cache_file}.$$";
+	eval {
+		nstore({
+			version        => $_cache_version,
+			eprefix        => $_EPREFIX,
+			manifest       => \%_manifest,
+			overlay        => $_PORTDIR_OVERLAY,
+			portdir        => $_PORTDIR,
+			use_flags      => $use_flags,
+			vdb            => \%_vdb_state
+		}, $tmp);
+		rename($tmp, $_cache_file)
+			or die "Unable to rename $tmp: $!\n";
+		1;
+	} or do {
+		debugMsg("Unable to write $_cache_file: $@");
+		-e $tmp and unlink $tmp;
+	};
+
+	return;
+}
 
-	for my $key (map {my $x=lc($_)."_"; $x } keys %$hidden) {
-		for my $flag (keys %$_use_temp) {
-			if ($flag =~ /^$key/ ) {
-				delete($_use_temp->{$flag});
-			} 
+
+# Read the given categories of /var/db/pkg using the native $vdb_scanner.
+# The signature of the first category read is checked against
+# _get_signature(), so a scanner signing differently is not trusted.
+# Parameter: list of categories to read
+# return: hash of category => state as described in _read_vdb_category(),
+#         empty if the scanner is not available or failed.
+sub _scan_vdb {
+	my @cats   = @_;
+	my %result = ();
+	my $state  = undef;
+
+	( @cats
+	  && length($vdb_scanner)
+	  && -x $vdb_scanner )
+		or return %result;
+
+	debugMsg("Scanning " . scalar(@cats) . " categories with $vdb_scanner");
+	open(my $scan, '-|', $vdb_scanner, "--vdb", "${_EPREFIX}/var/db/pkg", @cats)
+		or return %result;
+	while (my $line = <$scan>) {
+		chomp $line;
+		if ($line =~ /^C\t([^\t]+)\t(\S+)$/) {
+			$state = $result{$1} = { sig => $2, pkgs => {} };
+		} elsif (defined($state) && ($line =~ /^P\t([^\t]+)\t(\S+)\t(.*)$/)) {
+			$state->{pkgs}{$1} = { sig => $2, iuse => [ split(' ', $3) ] };
+		}
+	}
+
+	# Nothing is trusted if the scanner failed
+	close($scan)
+		or debugMsg("$vdb_scanner failed, falling back to Perl")
+		and %result = ();
+
+	# Signatures that differ from _get_signature() would never match again
+	my ($first) = grep { defined($result{$_}) } @cats;
+	defined($first)
+		and ($result{$first}{sig} ne _get_signature("${_EPREFIX}/var/db/pkg/$first"))
+		and debugMsg("$vdb_scanner signature of $first differs, falling back to Perl")
+		and %result = ();
+
+	return %result;
+}
+
+
+# Take $_PORTDIR and $_PORTDIR_OVERLAY from the cache, so eix and portageq
+# need not be asked again. This is only done if EPREFIX and all paths read so
+# far, make.globals, make.conf and repos.conf included, are unchanged since
+# the cache was written.
+# No parameters accepted.
+# return: 1 if the cached values are used, 0 otherwise.
+sub _use_cached_portdir {
+	my $cache = _read_cache
+		or return 0;
+
+	$_EPREFIX eq $cache->{eprefix}
+		or return 0;
+	for my $path (keys %_manifest) {
+		( defined($cache->{manifest}{$path})
+		  && ($_manifest{$path} eq $cache->{manifest}{$path}) )
+			or debugMsg("Cached PORTDIR outdated by $path")
+			and return 0;
+	}
+
+	$_PORTDIR         = $cache->{portdir};
+	$_PORTDIR_OVERLAY = $cache->{overlay};
+	debugMsg("Using cached PORTDIR");
+
+	return 1;
+}
+
+
+# Enumerate each directory in @_profiles once and sort the files found into
+# %_profile_files by their name. This way the readers neither have to check
+# for their files in each profile, nor need a second look into any profile.
+# The order of @_profiles is kept for each file name.
+# No parameters accepted.
+sub _walk_profiles {
+	my %listed = ();
+	%_profile_files = map { $_ => [] } qw{
+		arch.list make.defaults package.use package.use.force
+		package.use.mask use.desc use.force use.local.desc use.mask };
+
+	for my $dir (@_profiles) {
+		if (!defined($listed{$dir})) {
+			# Added or removed files change the directory signature
+			_note_input($dir);
+			$listed{$dir} = [];
+			if (opendir(my $dh, $dir)) {
+				$listed{$dir} = [ sort grep { defined($_profile_files{$_}) } readdir $dh ];
+				closedir $dh;
+			}
 		}
-	} ## Done looping USE_EXPAND_HIDDEN
+		push @{$_profile_files{$_}}, "$dir/$_" for (@{$listed{$dir}});
+	}
 
 	return;
 }
@@ -4,104 +4,399 @@
 #include <errno.h>
 #include <limits.h>
 #include <locale.h>
+#include <poll.h>
 #include <stdlib.h>
 #include <string.h>
 #include <strings.h>
 #include <unistd.h>
 
 #include "ufed-curses-help.h"
+#include "ufed-curses-search.h"
+#include "ufed-curses-vdb.h"
+
+/** @brief size of a newly started payload block
+**/
+#define PAYLOAD_BLOCK_SIZE (1 << 16)
+
+/** @brief maximum length of the text to search for with '/'
+**/
+#define SEARCH_TEXT_SIZE 64
+
+
+/* internal types */
+
+/** @struct sPayload_
+ *  @brief one block of the flag payload
+ *  Flags and descriptions point into the blocks, so a block is never moved
+ *  once flags have been read from it.
+**/
+typedef struct sPayload_ {
+	struct sPayload_* prev;   //!< the block filled before this one, if any
+	size_t            size;   //!< allocated size of data
+	size_t            len;    //!< used length of data
+	char              data[]; //!< the raw flag payload
+} sPayload;
+
+
+/** @struct sFaytRange_
+ *  @brief range of nameIndex matching the first characters of fayt
+**/
+typedef struct sFaytRange_ {
+	int hi; //!< entry after the last match
+	int lo; //!< first match
+} sFaytRange;
+
 
 /* internal members */
-static int     descriptionleft = 0;
-static sFlag** faytsave        = NULL;
-static size_t  maxDescWidth    = 0;
-static char*   lineBuf         = NULL;
-static sFlag*  flags           = NULL;
+static sArena*     arena           = NULL;
+static int         batchLeft       = 0;
+static int         descriptionleft = 0;
+static char**      dictionary      = NULL;
+static uint32_t    dictLeft        = 0;
+static uint32_t    dictLen         = 0;
+static uint32_t    dictSize        = 0;
+static sFaytRange* faytrange       = NULL;
+static int*        faytsave        = NULL;
+static bool        isInDictionary  = false;
+static bool        isStreamed      = false;
+static sNameIndex  nameIndex       = { 0, NULL, 0 };
+static sPayload*   payload         = NULL;
+static size_t      payloadPos      = 0;
+static char        searchText[SEARCH_TEXT_SIZE + 1] = "";
+static sFlagList   flags           = { 0, NULL, 0 };
 
 /* internal prototypes */
-static int  findFlagStart(sFlag* flag, int* index, sWrap** wrap, int* line);
 static void free_flags(void);
+static bool load_flags(void);
+static void editSearch(int* curr);
 static char getFlagSpecialChar(sFlag* flag, int index);
+static int  narrowFayt(size_t fLen);
+static void selectFound(int* curr, int idx);
 static void printFlagInfo(char* buf, sFlag* flag, int index, bool printFlagName, bool printFlagState);
-static void setFlagWrapDraw(sFlag* flag, int index, sWrap** wrap, size_t* pos, size_t* len);
+static void putCells(WINDOW* win, int line, const chtype* cells, int len, bool isAscii);
 
 
 /* static functions */
-static char *get_line(FILE *fp)
+
+/** @brief allocate a new payload block that can hold @a size bytes
+**/
+static sPayload* new_payload(size_t size)
 {
-	static size_t size = LINE_MAX;
+	sPayload* block = (sPayload*)malloc(sizeof(sPayload) + size);
+
+	if (NULL == block)
+		ERROR_EXIT(-1, "Can not allocate %lu bytes for flag payload\n", size)
+	block->prev = NULL;
+	block->size = size;
+	block->len  = 0;
+
+	return block;
+}
 
-	if (NULL == lineBuf) {
-		lineBuf = malloc(size);
-		if (NULL == lineBuf)
-			ERROR_EXIT(-1, "Can not allocate %lu bytes for line buffer\n", sizeof(char) * size);
-	}
 
-	if(fgets(lineBuf, size, fp) == NULL)
-		return NULL;
-	else {
-
-		/* See to configuration bytes if not read already */
-		if (!configDone) {
-			/* Byte 1: Whether read-only-mode is set or not */
-			if ( '0' != lineBuf[0] )
-				ro_mode = true;
-
-			configDone = true;
-
-			/* Remove the leading bytes transporting configuration values */
-			char *oldLine = lineBuf;
-			lineBuf = malloc(size);
-			if (NULL == lineBuf)
-				ERROR_EXIT(-1, "Can not allocate %lu bytes for line buffer\n", sizeof(char) * size);
-			memcpy(lineBuf, oldLine + 1, size - 1);
-			free(oldLine);
-		} /* End of having to read configuration bytes */
-
-		char *p = strchr(lineBuf, '\n');
-		if(p != NULL) {
-			*p = '\0';
-			return lineBuf;
+/** @brief read the next chunk of the flag payload from fd 3
+ *  If the current block is full, it is enlarged if @a grow is true, which is
+ *  only allowed as long as nothing points into it. Otherwise a new block is
+ *  started and the incomplete record at the end of the full block is moved
+ *  there. One byte is always kept free to 0-terminate the payload, so the
+ *  text format can be parsed in place.
+ *  @return false on end of input, true otherwise.
+**/
+static bool read_payload(bool grow)
+{
+	ssize_t got = 0;
+
+	if ((payload->len + 1) >= payload->size) {
+		if (grow) {
+			size_t    newSize = payload->size * 2;
+			sPayload* block   = (sPayload*)realloc(payload, sizeof(sPayload) + newSize);
+			if (NULL == block)
+				ERROR_EXIT(-1, "Can not reallocate %lu bytes for flag payload\n", newSize)
+			payload       = block;
+			payload->size = newSize;
+		} else {
+			size_t    rest  = payload->len - payloadPos;
+			sPayload* block = new_payload(rest < (PAYLOAD_BLOCK_SIZE / 2)
+			                              ? PAYLOAD_BLOCK_SIZE : rest * 2);
+			memcpy(block->data, payload->data + payloadPos, rest);
+			block->len   = rest;
+			block->prev  = payload;
+			payload->len = payloadPos;
+			payload      = block;
+			payloadPos   = 0;
 		}
 	}
-	for(;;) {
-		char *newLine = realloc(lineBuf, size + size / 2);
-		if(newLine == NULL)
-			ERROR_EXIT(-1, "Can not reallocate %lu bytes for line buffer\n",
-				(size_t)(sizeof(char) * size * 1.5));
-		lineBuf = newLine;
-		newLine = NULL;
-		if(fgets(lineBuf + size, size / 2, fp) == NULL)
-			return NULL;
-		else {
-			char *p = strchr(lineBuf + size, '\n');
-			if(p != NULL) {
-				*p = '\0';
-				return lineBuf;
-			}
+
+	do got = read(3, payload->data + payload->len, payload->size - payload->len - 1);
+	while ( (got < 0) && (EINTR == errno) );
+	if (got < 0)
+		ERROR_EXIT(-1, "Reading flags failed with error %d\n", errno)
+
+	payload->len += got;
+	payload->data[payload->len] = '\0';
+
+	return got > 0;
+}
+
+
+/** @brief decode an u32 from the binary payload
+**/
+static inline uint32_t get_u32(const unsigned char* p)
+{
+	return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+
+/** @brief advance @a pos behind the next @a len bytes of the binary payload
+ *  @return false if the payload does not hold that many bytes, yet.
+**/
+static bool skip_bytes(size_t* pos, size_t len)
+{
+	if ( (len > payload->len) || (*pos > (payload->len - len)) )
+		return false;
+	*pos += len;
+
+	return true;
+}
+
+
+/** @brief advance @a pos behind the next string of the binary payload
+ *  @return false if the payload does not hold the full string, yet.
+**/
+static bool skip_string(size_t* pos)
+{
+	const unsigned char* p = (const unsigned char*)payload->data + *pos;
+
+	return skip_bytes(pos, 4) && skip_bytes(pos, (size_t)get_u32(p) + 1);
+}
+
+
+/** @brief return a pointer to the next @a len bytes of the binary payload
+ *  The read position @a pos is advanced behind the bytes.
+**/
+static const unsigned char* get_bytes(size_t* pos, size_t len)
+{
+	const unsigned char* result = (const unsigned char*)payload->data + *pos;
+
+	if (!skip_bytes(pos, len))
+		ERROR_EXIT(-1, "Flag payload truncated at byte %lu\n", *pos)
+
+	return result;
+}
+
+
+/** @brief read a length prefixed and 0-terminated string from the binary payload
+ *  @return pointer into the payload or NULL if the string is empty.
+**/
+static char* get_string(size_t* pos)
+{
+	uint32_t len = get_u32(get_bytes(pos, 4));
+	char*    str = (char*)get_bytes(pos, (size_t)len + 1);
+
+	if (str[len])
+		ERROR_EXIT(-1, "Unterminated string at byte %lu\n", *pos - 1)
+
+	return len ? str : NULL;
+}
+
+
+/** @brief read a dictionary reference from the binary payload
+ *  @return the referenced string or NULL if the ID is 0.
+**/
+static char* get_ref(size_t* pos)
+{
+	uint32_t id = get_u32(get_bytes(pos, 4));
+
+	if (id > dictLen)
+		ERROR_EXIT(-1, "Unknown string %u at byte %lu\n", id, *pos - 4)
+
+	return id ? dictionary[id - 1] : NULL;
+}
+
+
+/** @brief check whether the flag record at payloadPos has fully arrived
+**/
+static bool has_record(void)
+{
+	size_t               pos = payloadPos;
+	const unsigned char* p   = NULL;
+
+	if (!skip_string(&pos))
+		return false;
+	p = (const unsigned char*)payload->data + pos;
+	if (!skip_bytes(&pos, 3))
+		return false;
+
+	// Each description is its states and three references
+	return skip_bytes(&pos, (size_t)(p[1] | (p[2] << 8)) * 14);
+}
+
+
+/** @brief add the strings of the dictionary section at payloadPos
+ *  The strings are not copied, the dictionary points into the payload.
+ *  Each string is added as soon as it has arrived, so a large section
+ *  does not have to be held back.
+ *  @return false if the section has not fully arrived, yet.
+**/
+static bool read_dictionary(void)
+{
+	size_t               pos = payloadPos;
+	const unsigned char* p   = NULL;
+
+	// A new section starts with the number of its strings
+	if (!isInDictionary) {
+		if (!skip_bytes(&pos, 4))
+			return false;
+		dictLeft       = get_u32((const unsigned char*)payload->data + payloadPos);
+		payloadPos     = pos;
+		isInDictionary = true;
+
+		if ((dictLen + dictLeft) > dictSize) {
+			uint32_t newSize = max(dictSize * 2, dictLen + dictLeft);
+			char**   newDict = (char**)realloc(dictionary, sizeof(char*) * newSize);
+			if (NULL == newDict)
+				ERROR_EXIT(-1, "Can not reallocate %lu bytes for the dictionary\n",
+					sizeof(char*) * newSize)
+			dictionary = newDict;
+			dictSize   = newSize;
 		}
-		size += size/2;
 	}
-	return NULL; // never reached.
+
+	for ( ; dictLeft && skip_string(&pos) ; --dictLeft) {
+		if (NULL == (dictionary[dictLen++] = get_string(&payloadPos)))
+			ERROR_EXIT(-1, "Empty dictionary string %u\n", dictLen)
+	}
+
+	// The section ends with the number of flags in the batch
+	if (dictLeft || !skip_bytes(&pos, 2))
+		return false;
+	p              = get_bytes(&payloadPos, 2);
+	batchLeft      = p[0] | (p[1] << 8);
+	isInDictionary = false;
+
+	return true;
 }
 
-static void read_flags(void)
+
+/** @brief unpack @a count 2-bit states from @a bits into '+', '-' or ' '
+**/
+static void get_states(unsigned bits, char* state, int count)
+{
+	static const char stateChars[3] = { ' ', '+', '-' };
+
+	for (int i = 0; i < count; ++i, bits >>= 2) {
+		if ((bits & 3) > 2)
+			ERROR_EXIT(-1, "Illegal state bits 0x%x\n", bits)
+		state[i] = stateChars[bits & 3];
+	}
+}
+
+
+/** @brief add a flag and adapt the minimum width to its name
+**/
+static sFlag* add_flag(char* name, int lineNum, int ndesc, const char state[2])
+{
+	sFlag* newFlag = addFlagRef(&flags, &arena, name, lineNum, ndesc, state);
+
+	/* The minimum width of the left side display is:
+	 * Space + Selection + Space + name + Space + Mask brackets/Force plus.
+	 * = 1 + 3 + 1 + strlen(name) + 1 + 2
+	 * = strlen(name) + 8
+	 */
+	if( (int)(strlen(name) + 8) > minwidth)
+		minwidth = strlen(name) + 8;
+
+	return newFlag;
+}
+
+
+/** @brief decode all complete flags of the binary flag format (version 3)
+ *  The format is streamed, ufed.pl writes the header right away and the
+ *  rest once the flags are known. All numbers are little endian.
+ *  Header: "UFED", u8 version, u8 read-only mode
+ *  List  : u32 number of flags, u16 length of the longest flag name
+ *  Batch : u32 number of new strings, the strings, u16 number of flags,
+ *          the flags
+ *  Flag  : string name, u8 states (conf, default), u16 number of descriptions
+ *  Desc  : u16 states (global, installed, forced, masked, default, package,
+ *          pkguse), ref desc, ref desc_alt, ref pkg
+ *  String: u32 length, the bytes and a terminating 0-byte. Length 0 means
+ *          "not set".
+ *  Ref   : u32 ID of a string in the dictionary, the strings of all batches
+ *          are numbered from 1 on. ID 0 means "not set".
+ *  Each state is two bits: 0 = not set, 1 = enabled, 2 = disabled.
+ *  Flags are only read once they fully arrived, and bottomline is
+ *  advanced accordingly.
+**/
+static void read_flags_binary(void)
+{
+	int lineNum = bottomline;
+
+	for ( ; flagsLoaded < flagsTotal ; ++flagsLoaded, --batchLeft) {
+
+		// Each batch starts with the strings it adds to the dictionary
+		while ( (0 == batchLeft) && read_dictionary() ) ;
+		if ( (0 == batchLeft) || !has_record() )
+			break;
+
+		size_t               pos   = payloadPos;
+		char*                name  = get_string(&pos);
+		const unsigned char* p     = get_bytes(&pos, 3);
+		char                 state[7];
+		int                  ndesc = p[1] | (p[2] << 8);
+
+		get_states(p[0], state, 2);
+		if (NULL == name)
+			ERROR_EXIT(-1, "Flag %d has no name\n", flagsLoaded)
+
+		sFlag* newFlag = add_flag(name, lineNum, ndesc, state);
+
+		/* read description(s) and determine flag status */
+		for (int i = 0; i < ndesc; ++i, ++lineNum) {
+			p = get_bytes(&pos, 2);
+			get_states(p[0] | (p[1] << 8), state, 7);
+
+			char* desc     = get_ref(&pos);
+			char* desc_alt = get_ref(&pos);
+			char* pkg      = get_ref(&pos);
+
+			addFlagDesc(newFlag, pkg, desc ? desc : "", desc_alt ? desc_alt : "", state);
+		} // loop through description lines
+
+		// Update flag states
+		genFlagStats(newFlag);
+		payloadPos = pos;
+	} // loop through flags
+
+	bottomline = lineNum;
+}
+
+
+/** @brief decode the text flag format, which is kept for debugging
+ *  The first byte transports the read-only mode, the rest are lines
+ *  "<flag> [<conf><default>] <number of descriptions>" each followed
+ *  by that many lines
+ *  "\t<desc>\t<desc_alt>\t (<pkg>) [<global><installed><forced><masked><default><package><pkguse>]"
+**/
+static int read_flags_text(void)
 {
-	FILE*  input     = fdopen(3, "r");
 	int    lineNum   = 0;
-	char*  line      = NULL;
+	char*  line      = payload->data + 1;
+	char*  next      = NULL;
 	int    ndescr    = 0;
 	char   endChar   = 0;
-	size_t fullWidth = 0;
 	struct {
 		int start, end;
 	} name, desc, desc_alt, pkg, state;
 
-	if(input == NULL)
-		ERROR_EXIT(-1, "fdopen failed with error %d\n", errno);
-	atexit(&free_flags);
+	/* Byte 1: Whether read-only-mode is set or not */
+	if ( '0' != payload->data[0] )
+		ro_mode = true;
+	configDone = true;
 
-	for(line = get_line(input); line ; line = get_line(input)) {
+	for ( ; line && *line ; line = next) {
+		if ( (next = strchr(line, '\n')) )
+			*next++ = '\0';
 		name.start  = name.end  = -1;
 		state.start = state.end = -1;
 
@@ -118,15 +413,7 @@ static void read_flags(void)
 		// Create a new flag
 		line[name.end]  = '\0';
 		line[state.end] = '\0';
-		sFlag* newFlag = addFlag(&flags, &line[name.start], lineNum, ndescr, &line[state.start]);
-
-		/* The minimum width of the left side display is:
-		 * Space + Selection + Space + name + Space + Mask brackets/Force plus.
-		 * = 1 + 3 + 1 + strlen(name) + 1 + 2
-		 * = strlen(name) + 8
-		 */
-		if( (name.end - name.start + 8) > minwidth)
-			minwidth = name.end - name.start + 8;
+		sFlag* newFlag = add_flag(&line[name.start], lineNum, ndescr, &line[state.start]);
 
 		/* read description(s) and determine flag status */
 		for (int i = 0; i < ndescr; ++i) {
@@ -135,8 +422,10 @@ static void read_flags(void)
 			pkg.start      = pkg.end      = -1;
 			state.start    = state.end    = -1;
 
-			line = get_line(input);
-			if (!line) break;
+			line = next;
+			if (!line || !*line) break;
+			if ( (next = strchr(line, '\n')) )
+				*next++ = '\0';
 
 			if ( (sscanf(line, "\t%n%*[^\t]%n\t%n%*[^\t]%n\t (%n%*[^)]%n) [%n%*[ +-]%n%c",
 					&desc.start,  &desc.end,
@@ -157,118 +446,150 @@ static void read_flags(void)
 			line[state.end]    = '\0';
 			if ( (pkg.end - pkg.start) > 1) {
 				line[pkg.end]   = '\0';
-				fullWidth = addFlagDesc(newFlag, &line[pkg.start], &line[desc.start],
-										&line[desc_alt.start], &line[state.start]);
+				addFlagDesc(newFlag, &line[pkg.start], &line[desc.start],
+						&line[desc_alt.start], &line[state.start]);
 			} else
-				fullWidth = addFlagDesc(newFlag, NULL, &line[desc.start],
-										&line[desc_alt.start], &line[state.start]);
-
-			// Note new max length if this line is longest:
-			if (fullWidth > maxDescWidth)
-				maxDescWidth = fullWidth;
+				addFlagDesc(newFlag, NULL, &line[desc.start],
+						&line[desc_alt.start], &line[state.start]);
 
 			// Advance lineNum
 			++lineNum;
 		} // loop through description lines
 
-		// Update flag states and add data to the list stats
+		// Update flag states
 		genFlagStats(newFlag);
-		addLineStats(newFlag, &listStats);
 	} // loop while input given
 
-	fclose(input);
+	return lineNum;
+}
+
 
-	if(flags == NULL)
+/** @brief read the start of the flag payload from fd 3
+ *  With the binary format only the header is read, the flags follow once
+ *  ufed.pl knows them, see read_flags_list() and load_flags(). The text
+ *  format is read completely.
+**/
+static void read_flags(void)
+{
+	atexit(&free_flags);
+	payload = new_payload(PAYLOAD_BLOCK_SIZE);
+
+	while ( (payload->len < 6) && read_payload(true) ) ;
+
+	// The binary format is used unless ufed.pl is debugging the text format
+	if ( (payload->len >= 6) && !memcmp(payload->data, "UFED", 4) ) {
+		if (3 != (unsigned char)payload->data[4])
+			ERROR_EXIT(-1, "Unsupported flag payload version %u\n",
+				(unsigned char)payload->data[4])
+		ro_mode    = payload->data[5] ? true : false;
+		configDone = true;
+		isStreamed = true;
+		payloadPos = 6;
+		return;
+	}
+
+	while (read_payload(true)) ;
+	if (payload->len)
+		// Save the last line, it is needed in several places
+		bottomline = read_flags_text();
+
+	if (0 == flags.count)
 		ERROR_EXIT(-1, "Unable to start: %s\n", "No Input!");
+}
 
-	// Save the last line, it is needed in several places
-	bottomline = lineNum;
+
+/** @brief wait for the flag list of the binary format and its first flags
+ *  Returns once the number of flags and the longest name are known, and
+ *  enough flags to fill the list window have arrived.
+**/
+static void read_flags_list(void)
+{
+	const unsigned char* p = NULL;
+
+	while ((payload->len - payloadPos) < 6) {
+		if (!read_payload(false))
+			ERROR_EXIT(-1, "Unable to start: %s\n", "No Input!");
+	}
+
+	p          = get_bytes(&payloadPos, 6);
+	flagsTotal = (int)get_u32(p);
+	if (0 == flagsTotal)
+		ERROR_EXIT(-1, "Unable to start: %s\n", "No Input!");
+
+	// See add_flag() for the minimum width
+	minwidth = (p[4] | (p[5] << 8)) + 8;
+
+	// The interface works with the table while it is filled
+	reserveFlags(&flags, flagsTotal);
+
+	while ( (flagsLoaded < min(flagsTotal, wHeight(List))) && load_flags() ) ;
 }
 
 
-static int drawflag(sFlag* flag, bool highlight)
+/** @brief read and decode the flags that are available on fd 3
+ *  This must only be called if fd 3 is readable or blocking is fine.
+ *  @return true if more flags are to come, false if all are read.
+**/
+static bool load_flags(void)
 {
-	// Return early if there is nothing to display:
-	if (!isFlagLegal(flag))
-		return 0;
+	// The search worker must not read the list while it grows
+	waitSearch();
 
-	// Basic values for the flag display
-	int    idx       = 0;    // The description index to start with
-	int    line      = flag->currline;
-	int    usedY     = 0;    // Counts how many lines this flag really needs to display
-	sWrap* wrapPart  = NULL; // Wrap part to begin with/draw
+	bool hasMore = read_payload(false);
 
-	// Get the starting description/wrapped line of the flag
-	usedY = findFlagStart(flag, &idx, &wrapPart, &line);
+	read_flags_binary();
+	if (!hasMore && (flagsLoaded < flagsTotal))
+		ERROR_EXIT(-1, "Flag payload truncated after %d of %d flags\n",
+			flagsLoaded, flagsTotal)
+
+	return flagsLoaded < flagsTotal;
+}
 
-	// findFlagStart returns -1 if the flag is out of the screen
-	if (0 > usedY)
-		return 0;
 
+static void drawflag(sFlag* flag, int line, const sRow* row, int count, bool highlight)
+{
 	// Window values (aka shortcuts)
 	WINDOW* wLst    = win(List);
-	int     lHeight = wHeight(List);
 	int     lWidth  = wWidth(List);
 
 	// Set up needed buffers
 	char   buf[lWidth + 1];        // Buffer for the line to print
-	char   desc[maxDescWidth + 1]; // Buffer to assemble the description accoring to e_order and e_desc
-	char   special, *pBuf;         // force/mask/none character, Helper to fill buf
-	memset(buf,  ' ', sizeof(char) * lWidth);
-	memset(desc, ' ', sizeof(char) * maxDescWidth);
-	buf[lWidth]        = 0x0;
-	desc[maxDescWidth] = 0x0;
+	chtype cells[lWidth];          // The line with its attributes as put on the screen
+	char   special = ' ', *pBuf;   // force/mask/none character, Helper to fill buf
+	buf[lWidth] = 0x0;
 
 	// Description and wrapped lines state values
-	bool   hasHead       = false;                 // Set to true once the left side (flag name and states) are printed
+	const
+	sDescText* text      = NULL;                  // The description assembled according to e_order and e_desc
+	const
+	char*  desc          = NULL;                  // The text of text
+	int    idx           = -1;                    // The description desc was assembled for
 	int    rightwidth    = lWidth - minwidth - 8; // Space on the right to print descriptions
 	size_t length        = rightwidth;            // Characters to print when not wrapping
-	bool   newDesc       = true;                  // Set to fals when wrapped parts advance
 	size_t pos           = descriptionleft;       // position in desc to start printing on
-	int    leftover      = 0;                     // When wrapping lines, this is left on the right
-
-	// Safety check: Put in blank line if idx ended up too large
-	if (idx >= flag->ndesc) {
-		// This can happen when filters reduce the list too much
-		// so blank lines must be displayed
-		memset(buf, ' ', lWidth - 1);
-		waddstr(wLst, buf);
-	}
+	int    space         = 0;                     // Space on the right of this line
+	chtype attr          = 0;                     // Attributes in effect for the next cells
+	bool   isAscii       = true;                  // false if the line has multibyte characters
 
-	// print descriptions according to filters
-	while ( (idx < flag->ndesc) && (line < lHeight) ) {
-
-		// Continue if any of the filters apply:
-		if (newDesc && !isDescLegal(flag, idx)) {
-			++idx;
-			continue;
-		}
+	// print the given rows, the first one gets the flag head
+	for (int i = 0; i < count; ++i, ++line, ++row) {
+		bool hasHead = i > 0;
+		bool newDesc = !hasHead || (row[-1].desc != row->desc);
 
 		// Always start with a blanked buffer
 		memset(buf,  ' ', sizeof(char) * lWidth);
 
-		// Prepare new description or blank on wrapped parts
-		if (newDesc) {
+		// Prepare new description
+		if (idx != row->desc) {
+			idx     = row->desc;
 			special = getFlagSpecialChar(flag, idx);
 
-			// Always start with a blank description buffer
-			memset(desc, ' ', sizeof(char) * maxDescWidth);
-
 			// Wrapped and not wrapped lines are unified here
 			// to simplify the usage of different ordering and
-			// stripped descriptions versus original descriptions
-			if (flag->desc[idx].pkg) {
-				if (e_order == eOrder_left)
-					sprintf(desc, "(%s) %s", flag->desc[idx].pkg, e_desc == eDesc_ori
-							? flag->desc[idx].desc
-							: flag->desc[idx].desc_alt);
-				else
-					sprintf(desc, "%s (%s)", e_desc == eDesc_ori
-							? flag->desc[idx].desc
-							: flag->desc[idx].desc_alt,
-							  flag->desc[idx].pkg);
-			} else
-				sprintf(desc, "%s", flag->desc[idx].desc);
+			// stripped descriptions versus original descriptions.
+			// The text is only assembled again if one of them changed.
+			text = getDescText(&flag->desc[idx]);
+			desc = text->text;
 		}
 
 		/* --- Preparations done --- */
@@ -281,101 +602,235 @@ static int drawflag(sFlag* flag, bool highlight)
 		// At this point buf is guaranteed to be filled up to minwidth + 8
 
 		// For normal descriptions, pos and length are already set, but
-		// not so for wrapped lines, these must be set for each line:
-		if (eWrap_wrap == e_wrap)
-			setFlagWrapDraw(flag, idx, &wrapPart, &pos, &length);
-
-		// The right side of buf can be added now:
-		leftover = rightwidth - (int)length - (newDesc ? 0 : 2);
-		pBuf     = &buf[minwidth + (newDesc ? 8 : 10)];
-		sprintf(pBuf, "%-*.*s",
-			(int)length, (int)length,
-			strlen(desc) > pos ? &desc[pos] : " ");
-		// Note: Follow up lines of wrapped descriptions are indented by 2
+		// not so for wrapped lines, these are given by the row:
+		if (row->wrap) {
+			pos    = row->wrap->pos;
+			length = row->wrap->len;
+		}
 
-		// Leftover characters on the right must be blanked:
-		if (leftover > 0)
-			sprintf(pBuf + length, "%-*s", leftover, " ");
+		// The right side of buf can be added now, the rest is blank already:
+		// Note: Follow up lines of wrapped descriptions are indented by 2
+		pBuf  = &buf[minwidth + (newDesc ? 8 : 10)];
+		space = rightwidth - (newDesc ? 0 : 2);
+		if ((text->len > pos) && (space > 0))
+			memcpy(pBuf, &desc[pos], min(min(text->len - pos, length), (size_t)space));
 
 		/* Set correct color set according to highlighting and status*/
-		if(highlight)
-			wattrset(wLst, COLOR_PAIR(3) | A_BOLD | A_REVERSE);
-		else
-			wattrset(wLst, COLOR_PAIR(3));
-
-		// Put the line on the screen
-		mvwaddstr(wLst, line, 0, buf);
-		mvwaddch(wLst, line, minwidth,     ACS_VLINE); // Before state
-		mvwaddch(wLst, line, minwidth + 4, ACS_VLINE); // Between state and scope
-		mvwaddch(wLst, line, minwidth + 7, ACS_VLINE); // After scope
+		attr = highlight ? COLOR_PAIR(3) | A_BOLD | A_REVERSE : COLOR_PAIR(3);
+
+		// Render the line into cells, the attributes are applied right away
+		isAscii = true;
+		for (int x = 0; x < lWidth; ++x) {
+			cells[x] = (unsigned char)buf[x] | attr;
+			if (buf[x] & 0x80)
+				isAscii = false;
+		}
+		cells[minwidth]     = ACS_VLINE | attr; // Before state
+		cells[minwidth + 4] = ACS_VLINE | attr; // Between state and scope
+		cells[minwidth + 7] = ACS_VLINE | attr; // After scope
+
+		// Mark what the last search found in the shown part of the description
+		for (const char* found = findQuery(desc); found; found = findQuery(found + 1)) {
+			int start = max((int)(found - desc), (int)pos);
+			int end   = min((int)(found - desc + strlen(searchText)), (int)(pos + length));
+			int x     = minwidth + (newDesc ? 8 : 10) + start - pos;
+			for ( ; (start < end) && (x < lWidth); ++start, ++x)
+				cells[x] = (cells[x] & A_CHARTEXT) | COLOR_PAIR(3)
+						 | (highlight ? A_BOLD : A_BOLD | A_REVERSE);
+		}
 
 		// Add (default) selection if this is the header line
 		if (!hasHead) {
-			hasHead = true;
 			if (flag->globalForced) {
-				if(highlight)
-					wattrset(wLst, COLOR_PAIR(5) | A_REVERSE);
-				else
-					wattrset(wLst, COLOR_PAIR(5) | A_BOLD);
-				mvwaddch(wLst, line, 2, '+');
+				attr = highlight ? COLOR_PAIR(5) | A_REVERSE : COLOR_PAIR(5) | A_BOLD;
+				cells[2] = '+' | attr;
 			} else if (flag->globalMasked) {
-				if(highlight)
-					wattrset(wLst, COLOR_PAIR(4) | A_REVERSE);
-				else
-					wattrset(wLst, COLOR_PAIR(4) | A_BOLD);
-				mvwaddch(wLst, line, 2, '-');
+				attr = highlight ? COLOR_PAIR(4) | A_REVERSE : COLOR_PAIR(4) | A_BOLD;
+				cells[2] = '-' | attr;
 			} else if (' ' == flag->stateConf)
-				mvwaddch(wLst, line, 2, flag->stateDefault);
+				cells[2] = (unsigned char)flag->stateDefault | attr;
 			else
-				mvwaddch(wLst, line, 2, flag->stateConf);
+				cells[2] = (unsigned char)flag->stateConf | attr;
 		}
 
 		// Add [D]efault column content
 		if ('f' == special) {
-			if(highlight)
-				wattrset(wLst, COLOR_PAIR(5) | A_REVERSE);
-			else
-				wattrset(wLst, COLOR_PAIR(5) | A_BOLD);
-			mvwaddch(wLst, line, minwidth + 1, special);
+			attr = highlight ? COLOR_PAIR(5) | A_REVERSE : COLOR_PAIR(5) | A_BOLD;
+			cells[minwidth + 1] = special | attr;
 		} else if ('m' == special) {
-			if(highlight)
-				wattrset(wLst, COLOR_PAIR(4) | A_REVERSE);
-			else
-				wattrset(wLst, COLOR_PAIR(4) | A_BOLD);
-			mvwaddch(wLst, line, minwidth + 1, special);
-		} else {
-			if (' ' == flag->desc[idx].stateDefault)
-				mvwaddch(wLst, line, minwidth + 1, flag->stateDefault);
-			else
-				mvwaddch(wLst, line, minwidth + 1, flag->desc[idx].stateDefault);
-		}
+			attr = highlight ? COLOR_PAIR(4) | A_REVERSE : COLOR_PAIR(4) | A_BOLD;
+			cells[minwidth + 1] = special | attr;
+		} else if (' ' == flag->desc[idx].stateDefault)
+			cells[minwidth + 1] = (unsigned char)flag->stateDefault | attr;
+		else
+			cells[minwidth + 1] = (unsigned char)flag->desc[idx].stateDefault | attr;
 
-		// Advance counters and possibly description index
-		++line;
-		++usedY;
+		// Put the line on the screen
+		putCells(wLst, line, cells, lWidth, isAscii);
+	} // end of looping rows
 
-		// When wrapping the wrapPart must be advanced and checked
-		if (eWrap_wrap == e_wrap) {
-			wrapPart = wrapPart ? wrapPart->next : NULL;
-			if (wrapPart)
-				newDesc = false;
-			else
-				newDesc = true;
+	if(highlight)
+		wmove(wLst, line - count, 2);
+	wnoutrefresh(wLst);
+}
+
+/** @brief bring the ranges of nameIndex matching the first @a fLen characters of fayt up to date
+ *  Each range is narrowed from the one of the prefix one character
+ *  shorter, so the shorter ranges stay valid for backspace. If flags
+ *  were added since the index was built, it is rebuilt and all ranges
+ *  are narrowed again.
+ *  @return the number of flags matching, filtered or not.
+**/
+static int narrowFayt(size_t fLen)
+{
+	size_t pos = fLen;
+
+	if (nameIndex.count != flags.count) {
+		buildNameIndex(&nameIndex, &flags);
+		faytrange[0].lo = 0;
+		faytrange[0].hi = nameIndex.count;
+		pos = 1;
+	}
+
+	for ( ; pos && (pos <= fLen); ++pos) {
+		faytrange[pos] = faytrange[pos - 1];
+		narrowNameRange(&nameIndex, &flags, pos - 1, fayt[pos - 1],
+			&faytrange[pos].lo, &faytrange[pos].hi);
+	}
+
+	return faytrange[fLen].hi - faytrange[fLen].lo;
+}
+
+
+/** @brief let the user type the text to search for after '/' was pressed
+ *  Every change of the text starts a new search in the background, see
+ *  startSearch(). While the keyboard is watched, the hits are read as the
+ *  worker posts them, and the best ranked flag is selected. Of equally
+ *  ranked flags the first from the current one on is taken. Enter waits
+ *  for the search to complete and keeps it, so Tab and BackTab can select
+ *  the other flags found. ESC ends it.
+**/
+static void editSearch(int* curr)
+{
+	WINDOW* wInp      = win(Input);
+	size_t  sLen      = 0;
+	int     found     = 0;
+	int     from      = *curr;
+	bool    doWait    = true;
+	bool    isRunning = false;
+
+	searchText[0] = '\0';
+	startSearch(&flags, searchText);
+
+	while (doWait) {
+		// Show the search text, in red if nothing is found
+		if (sLen && !found && !isRunning)
+			wattrset(wInp, COLOR_PAIR(4) | A_BOLD | A_REVERSE);
+		else
+			wattrset(wInp, COLOR_PAIR(5) | A_BOLD);
+		mvwaddch(wInp, 0, 0, '/');
+		waddstr(wInp, searchText);
+		wattrset(wInp, COLOR_PAIR(3));
+		whline(wInp, ' ', wWidth(Input) - sLen - 1);
+		wrefresh(wInp);
+
+		struct pollfd fds[2] = {
+			{ STDIN_FILENO,  POLLIN, 0 },
+			{ getSearchFd(), POLLIN, 0 }
+		};
+		int ready = poll(fds, 2, -1);
+
+		if ( (ready < 0) && (EINTR != errno) )
+			ERROR_EXIT(-1, "Waiting for input failed with error %d\n", errno)
+
+		if (fds[1].revents) {
+			isRunning = readSearch(&found);
+			selectFound(curr, findBestFound(&flags, from));
 		}
 
-		if (newDesc)
-			++idx;
+		// A signal like SIGWINCH might have a key pending, too.
+		if ( !fds[0].revents && (ready >= 0) )
+			continue;
+		nodelay(stdscr, TRUE);
+		int key = getch();
+		nodelay(stdscr, FALSE);
+
+		switch (key) {
+			case ERR:
+				continue;
+			case '\n':
+			case KEY_ENTER:
+				doWait = false;
+				break;
+			case '\033':
+				searchText[0] = '\0';
+				sLen   = 0;
+				doWait = false;
+				break;
+			case KEY_DC:
+			case 0177:
+			case KEY_BACKSPACE:
+				if (sLen)
+					searchText[--sLen] = '\0';
+				break;
+#ifdef KEY_RESIZE
+			case KEY_RESIZE:
+				// Let maineventloop() handle this
+				ungetch(key);
+				doWait = false;
+				break;
+#endif
+			default:
+				if ( (key == (unsigned char)key) && isprint(key)
+				  && (sLen < SEARCH_TEXT_SIZE) ) {
+					searchText[sLen]   = (char)key;
+					searchText[++sLen] = '\0';
+				} else
+					continue;
+				break;
+		}
 
-	} // end of looping flag descriptions
+		if (doWait) {
+			// The flag is selected when the hits arrive
+			from      = *curr;
+			found     = 0;
+			isRunning = sLen > 0;
+			startSearch(&flags, searchText);
+			touchFlags();
+			drawFlags();
+		} else if (sLen) {
+			// A kept search needs all its hits for Tab and BackTab
+			waitSearch();
+			readSearch(&found);
+			selectFound(curr, findBestFound(&flags, *curr));
+		} else {
+			startSearch(&flags, searchText);
+			touchFlags();
+			drawFlags();
+		}
+	}
 
-	if(highlight)
-		wmove(win(List), max(flag->currline, 0), 2);
+	drawStatus(true);
 	wnoutrefresh(win(List));
+	wrefresh(wInp);
+}
+
 
-	return usedY;
+/** @brief select flag @a idx found by the last search, if it is not -1
+ *  See findBestFound() and findNextFound(). The list is drawn completely,
+ *  because the marked matches change with the search.
+**/
+static void selectFound(int* curr, int idx)
+{
+	if (idx >= 0)
+		*curr = idx;
+	if (!scrollcurrent())
+		drawFlags();
+	wnoutrefresh(win(List));
 }
 
-static int callback(sFlag** curr, int key)
+
+static int callback(int* curr, int key)
 {
 	WINDOW* wInp = win(Input);
 	WINDOW* wLst = win(List);
@@ -385,6 +840,7 @@ static int callback(sFlag** curr, int key)
 	  && (key != KEY_BACKSPACE)
 	  && (key != KEY_DC)
 	  && (key != 0177)
+	  && (key != '\t')
 	  && ( (key == ' ') || (key != (unsigned char)key) || !isprint(key)) ) {
 		fayt[0] = '\0';
 		drawStatus(true);
@@ -395,7 +851,7 @@ static int callback(sFlag** curr, int key)
 	// Reset possible side scrolling of the current flags description first
 	if(descriptionleft && (key != KEY_LEFT) && (key != KEY_RIGHT) ) {
 		descriptionleft = 0;
-		drawflag(*curr, TRUE);
+		drawFlag(*curr, TRUE);
 	}
 
 	switch(key) {
@@ -406,18 +862,48 @@ static int callback(sFlag** curr, int key)
 			if(0 == fLen)
 				break;
 			fayt[--fLen] = '\0';
-			drawflag(*curr, FALSE);
+			drawFlag(*curr, FALSE);
 			*curr = faytsave[fLen];
 			if (!scrollcurrent())
-				drawflag(*curr, TRUE);
+				drawFlag(*curr, TRUE);
 			wattrset(wInp, COLOR_PAIR(5) | A_BOLD);
 			mvwaddstr(wInp, 0, 0, fayt);
 			whline(wInp, ' ', 2);
 			if(fLen == 0)
-				wmove(wLst, (*curr)->currline, 2);
+				wmove(wLst, flags.flag[*curr].currline, 2);
 			wnoutrefresh(wLst);
 			wrefresh(wInp);
 			break;
+		case '/':
+			fayt[0] = '\0';
+			editSearch(curr);
+			break;
+		case KEY_BTAB:
+			if (searchText[0])
+				selectFound(curr, findNextFound(&flags, *curr - 1, false));
+			break;
+		case '\t':
+			// Select the next flag matching the typed characters,
+			// or the next one found by the last search
+			fLen = strlen(fayt);
+			if (!fLen && searchText[0])
+				selectFound(curr, findNextFound(&flags, *curr + 1, true));
+			else if (fLen && !strncasecmp(flags.flag[*curr].name, fayt, fLen)) {
+				int idx = *curr;
+				if (narrowFayt(fLen))
+					idx = findNameMatch(&nameIndex, &flags,
+						faytrange[fLen].lo, faytrange[fLen].hi, *curr);
+				if ( (idx >= 0) && (idx != *curr) ) {
+					drawFlag(*curr, FALSE);
+					*curr = idx;
+					if (!scrollcurrent())
+						drawFlag(*curr, TRUE);
+				}
+				wmove(wInp, 0, fLen);
+				wnoutrefresh(wLst);
+				wrefresh(wInp);
+			}
+			break;
 		case '\n':
 		case KEY_ENTER:
 			if (ro_mode) {
@@ -435,25 +921,25 @@ static int callback(sFlag** curr, int key)
 			break;
 		case ' ':
 			// Masked flags can be turned off, nothing else
-			if ( (*curr)->globalMasked || (*curr)->globalForced ) {
-				if (' ' != (*curr)->stateConf)
-					(*curr)->stateConf = ' ';
+			if ( flags.flag[*curr].globalMasked || flags.flag[*curr].globalForced ) {
+				if (' ' != flags.flag[*curr].stateConf)
+					flags.flag[*curr].stateConf = ' ';
 			} else {
-				switch ((*curr)->stateConf) {
+				switch (flags.flag[*curr].stateConf) {
 					case '+':
-						(*curr)->stateConf = '-';
+						flags.flag[*curr].stateConf = '-';
 						break;
 					case '-':
-						(*curr)->stateConf = ' ';
+						flags.flag[*curr].stateConf = ' ';
 						break;
 					default:
-						(*curr)->stateConf = '+';
+						flags.flag[*curr].stateConf = '+';
 						break;
 				}
 			}
-			if (*curr != flags) {
-				drawflag(*curr, TRUE);
-				wmove(wLst, (*curr)->currline, 2);
+			if (0 != *curr) {
+				drawFlag(*curr, TRUE);
+				wmove(wLst, flags.flag[*curr].currline, 2);
 				wrefresh(wLst);
 			} else
 				drawFlags();
@@ -462,16 +948,16 @@ static int callback(sFlag** curr, int key)
 			if (eWrap_normal == e_wrap) {
 				if(descriptionleft > 0)
 					descriptionleft -= min(descriptionleft, (wWidth(List) - minwidth) * 2 / 3);
-				drawflag(*curr, TRUE);
-				wmove(wLst, (*curr)->currline, 2);
+				drawFlag(*curr, TRUE);
+				wmove(wLst, flags.flag[*curr].currline, 2);
 				wrefresh(wLst);
 			}
 			break;
 		case KEY_RIGHT:
 			if (eWrap_normal == e_wrap) {
 				descriptionleft += (wWidth(List) - minwidth) * 2 / 3;
-				drawflag(*curr, TRUE);
-				wmove(wLst, (*curr)->currline, 2);
+				drawFlag(*curr, TRUE);
+				wmove(wLst, flags.flag[*curr].currline, 2);
 				wrefresh(wLst);
 			}
 			break;
@@ -482,7 +968,7 @@ static int callback(sFlag** curr, int key)
 			else
 				++e_scope;
 
-			if ( !isFlagLegal(*curr)
+			if ( !isFlagLegal(&flags.flag[*curr])
 			  && !setNextItem(0, true)
 			  && !setPrevItem(0, true) )
 				resetDisplay(true);
@@ -497,7 +983,7 @@ static int callback(sFlag** curr, int key)
 				++e_state;
 
 
-			if ( !isFlagLegal(*curr)
+			if ( !isFlagLegal(&flags.flag[*curr])
 			  && !setNextItem(0, true)
 			  && !setPrevItem(0, true) )
 				resetDisplay(true);
@@ -511,7 +997,7 @@ static int callback(sFlag** curr, int key)
 			else
 				++e_mask;
 
-			if ( !isFlagLegal(*curr)
+			if ( !isFlagLegal(&flags.flag[*curr])
 			  && !setNextItem(0, true)
 			  && !setPrevItem(0, true) )
 				resetDisplay(true);
@@ -550,25 +1036,25 @@ static int callback(sFlag** curr, int key)
 #ifdef NCURSES_MOUSE_VERSION
 		case KEY_MOUSE:
 			// Masked flags can be turned off, nothing else
-			if ( (*curr)->globalMasked || (*curr)->globalForced ) {
-				if (' ' != (*curr)->stateConf)
-					(*curr)->stateConf = ' ';
+			if ( flags.flag[*curr].globalMasked || flags.flag[*curr].globalForced ) {
+				if (' ' != flags.flag[*curr].stateConf)
+					flags.flag[*curr].stateConf = ' ';
 			} else {
-				switch ((*curr)->stateConf) {
+				switch (flags.flag[*curr].stateConf) {
 					case '+':
-						(*curr)->stateConf = '-';
+						flags.flag[*curr].stateConf = '-';
 						break;
 					case '-':
-						(*curr)->stateConf = ' ';
+						flags.flag[*curr].stateConf = ' ';
 						break;
 					default:
-						(*curr)->stateConf = '+';
+						flags.flag[*curr].stateConf = '+';
 						break;
 				}
 			}
-			if (*curr != flags) {
-				drawflag(*curr, TRUE);
-				wmove(wLst, (*curr)->currline, 2);
+			if (0 != *curr) {
+				drawFlag(*curr, TRUE);
+				wmove(wLst, flags.flag[*curr].currline, 2);
 				wrefresh(wLst);
 			} else {
 				drawFlags();
@@ -581,44 +1067,45 @@ static int callback(sFlag** curr, int key)
 			break;
 		default:
 			if( (key == (unsigned char) key) && isprint(key)) {
-				sFlag* flag = *curr;
+				int idx = *curr;
 				fLen = strlen(fayt);
-				if(fLen && strncasecmp(flag->name, fayt, fLen))
+				if(fLen && strncasecmp(flags.flag[idx].name, fayt, fLen))
 					--fLen;
 				fayt[fLen]     = (char) key;
 				faytsave[fLen] = *curr;
 				fayt[++fLen]   = '\0';
+				int matches    = narrowFayt(fLen);
 
 				wmove(wInp, 0, fLen);
 
 				/* if the current flag already matches the input string,
 				 * then update the input area only.
 				 */
-				if(!strncasecmp(flag->name, fayt, fLen)) {
+				if(!strncasecmp(flags.flag[idx].name, fayt, fLen)) {
 					wattrset(wInp, COLOR_PAIR(5) | A_BOLD);
 					mvwaddstr(wInp, 0, 0, fayt);
 					wrefresh(wInp);
 				}
 				/* if the current flag does not match, search one that does. */
 				else {
-					do flag = flag->next;
-					while( (flag != *curr)
-					    && ( ( strncasecmp(flag->name, fayt, fLen)
-					    	|| !isFlagLegal(flag)) ) );
+					idx = -1;
+					if (matches)
+						idx = findNameMatch(&nameIndex, &flags,
+							faytrange[fLen].lo, faytrange[fLen].hi, *curr);
 
 					/* if there was no match (or the match is filtered),
 					 * update the input area to show that there is no match
 					 */
-					if (flag == *curr) {
+					if ( (idx < 0) || (idx == *curr) ) {
 						wattrset(wInp, COLOR_PAIR(4) | A_BOLD | A_REVERSE);
 						mvwaddstr(wInp, 0, 0, fayt);
 						wmove(wInp, 0, fLen - 1);
 						wrefresh(wInp);
 					} else {
-						drawflag(*curr, FALSE);
-						*curr = flag;
+						drawFlag(*curr, FALSE);
+						*curr = idx;
 						if (!scrollcurrent())
-							drawflag(*curr, TRUE);
+							drawFlag(*curr, TRUE);
 						wattrset(wInp, COLOR_PAIR(5) | A_BOLD);
 						mvwaddstr(wInp, 0, 0, fayt);
 						wmove(wInp, 0, fLen);
@@ -632,90 +1119,24 @@ static int callback(sFlag** curr, int key)
 	return -1;
 }
 
-/** @brief find the first description/wrapped part drawn on line 0.
-  *
-  * Determine with which description to start.
-  * Overly long description lists might not fit on one screen,
-  * and therefore must be scrolled instead of the flags
-  * themselves.
-  * If descriptions are wrapped, any description must be held
-  * until wrapPart is either NULL, or a part on the screen is
-  * reached.
-**/
-static int findFlagStart(sFlag* flag, int* index, sWrap** wrap, int* line)
-{
-	int    usedLines  = 0;
-	int    flagHeight = getFlagHeight(flag); // Will recalculate wrap parts if needed
-	sWrap* wrapPart = NULL;
-
-	if (*line < 0) {
-
-		// Only do anything if the flag can reach the screen:
-		if (-(*line) >= flagHeight)
-			return -1;
-
-		// Now loop until the screen is entered (line == 0)
-		while (*line < 0) {
-			if (isDescLegal(flag, *index)) {
-				if (eWrap_normal == e_wrap) {
-					++(*line);
-					++(*index);
-					++usedLines;
-				} else {
-					/* With wrapped descriptions there are two possible
-					 * situations:
-					 * a) The list of wrapped lines is shorter than the
-					 *    lines to be skipped to get this description on
-					 *    the screen. In this case the full description
-					 *    can be fast forwareded.
-					 * b) The number of lines above the screen is less
-					 *    than the number of wrapped parts. In this case
-					 *    the first on screen part must be found.
-					 */
-					int wrapCount = flag->desc[*index].wrapCount;
-					wrapPart      = flag->desc[*index].wrap;
-					if (wrapPart && wrapCount && (-(*line) < wrapCount)) {
-						// Situation b) This description enters screen
-						while (wrapPart && (*line < 0)) {
-							++(*line);
-							++usedLines;
-							wrapPart = wrapPart->next;
-						}
-					} else {
-						// Situation a) Fast forward
-						*line     += wrapCount;
-						usedLines += wrapCount;
-						++(*index);
-					}
-				} // End of handling wrapped lines
-			} // End of having a legal flag
-			else
-				++(*index);
-		} // end of moving to line 0
-
-		// Write back wrapPart:
-		*wrap = wrapPart;
-	}
-
-	return usedLines;
-}
-
 static void free_flags(void)
 {
-	sFlag* flag = flags->prev;
-
-	// Clear all flags
-	while (flags) {
-		if (flag)
-			destroyFlag(&flags, &flag);
-		else
-			destroyFlag(&flags, &flags);
-		flag = flags ? flags->prev ? flags->prev : flags : NULL;
+	// Clear all flags, their descriptions all live in the arena
+	destroySearch();
+	destroyFlagList(&flags);
+	destroyNameIndex(&nameIndex);
+	destroyArena(&arena);
+	destroyWrapLayouts();
+	if (dictionary)
+		free(dictionary);
+	dictionary = NULL;
+
+	// Clear the payload blocks all flag strings point into
+	while (payload) {
+		sPayload* prev = payload->prev;
+		free(payload);
+		payload = prev;
 	}
-
-	// Clear line buffer
-	if (lineBuf)
-		free(lineBuf);
 }
 
 static char getFlagSpecialChar(sFlag* flag, int index)
@@ -731,8 +1152,16 @@ static char getFlagSpecialChar(sFlag* flag, int index)
 
 static void printFlagInfo(char* buf, sFlag* flag, int index, bool printFlagName, bool printFlagState)
 {
-	if (printFlagName) {
-		sprintf(buf, " %c%c%c %s%s%s%-*s ",
+	// The name column only changes with stateConf and the width, it is cached
+	if (printFlagName && ( (NULL == flag->info)
+						|| (flag->infoConf  != flag->stateConf)
+						|| (flag->infoWidth != minwidth) ) ) {
+		if (flag->infoWidth != minwidth) {
+			flag->info      = (char*)arenaAlloc(&arena, minwidth + 1);
+			flag->infoWidth = minwidth;
+		}
+		flag->infoConf = flag->stateConf;
+		snprintf(flag->info, minwidth + 1, " %c%c%c %s%s%s%-*s ",
 			/* State of selection */
 			flag->stateConf == ' ' ? '(' : '[',
 			' ', // Filled in later
@@ -745,9 +1174,11 @@ static void printFlagInfo(char* buf, sFlag* flag, int index, bool printFlagName,
 			(int)(minwidth
 				- (flag->globalForced ? 3 : flag->globalMasked ? 2 : 5)
 				- strlen(flag->name)), " ");
-		buf[minwidth] = ' '; // No automatic \0, please!
 	}
 
+	if (printFlagName)
+		memcpy(buf, flag->info, minwidth); // No automatic \0, please!
+
 	if (printFlagState) {
 		/* Display flag state
 		 * The order in which the states are to be displayed is:
@@ -758,53 +1189,78 @@ static void printFlagInfo(char* buf, sFlag* flag, int index, bool printFlagName,
 		 * 4. global/local
 		 * 5. installed/not installed
 		 */
-		sprintf(buf + minwidth, "  %c%c %c%c ",
-			flag->desc[index].statePackage,
-			' ' == flag->desc[index].statePkgUse ?
-				flag->stateConf : flag->desc[index].statePkgUse,
-			flag->desc[index].isGlobal ? ' ' : 'L',
-			flag->desc[index].isInstalled ? 'i' : ' ');
-		buf[minwidth + 8] = ' '; // No automatic \0, please!
+		char* pState = buf + minwidth; // Blanked already, the columns are set directly
+		pState[2] = flag->desc[index].statePackage;
+		pState[3] = ' ' == flag->desc[index].statePkgUse ?
+				flag->stateConf : flag->desc[index].statePkgUse;
+		pState[5] = flag->desc[index].isGlobal ? ' ' : 'L';
+		pState[6] = flag->desc[index].isInstalled ? 'i' : ' ';
 	}
 }
 
-static void setFlagWrapDraw(sFlag* flag, int index, sWrap** wrap, size_t* pos, size_t* len)
+
+/** @brief put @a len @a cells at the start of @a line of @a win
+ *  A line of single byte characters is put with one call. A chtype can
+ *  not hold a multibyte character, so other lines are put in runs of
+ *  equal attributes, and the bytes of each run are decoded by curses.
+**/
+static void putCells(WINDOW* win, int line, const chtype* cells, int len, bool isAscii)
 {
-	sWrap* wrapPart = *wrap;
-
-	if (NULL == wrapPart)
-		wrapPart = flag->desc[index].wrap;
-
-	// The length and position can be written back already
-	if (wrapPart) {
-		*pos = wrapPart->pos;
-		*len = wrapPart->len;
-	} else {
-		*pos = 0;
-		*len = 0;
+	if (isAscii) {
+		mvwaddchnstr(win, line, 0, cells, len);
+		return;
 	}
 
-	// Write back wrap part pointer
-	*wrap = wrapPart;
-}
+	char run[len + 1];
+	wmove(win, line, 0);
+	for (int x = 0; x < len; ) {
+		chtype attr = cells[x] & A_ATTRIBUTES;
+		int    rLen = 0;
 
+		wattrset(win, attr);
+		if (attr & A_ALTCHARSET)
+			waddch(win, cells[x++]);
+		else {
+			while ( (x < len) && ((cells[x] & A_ATTRIBUTES) == attr) )
+				run[rLen++] = (char)(cells[x++] & A_CHARTEXT);
+			waddnstr(win, run, rLen);
+		}
+	}
+}
 
-int main(void)
+int main(int argc, char* argv[])
 {
 	int result = EXIT_SUCCESS;
 	const char subtitle_ro[] = "USE flags can be browsed, but changes will NOT be saved!";
 	const char subtitle_rw[] = "Select desired USE flags from the list below:";
 
+	/* Portage.pm uses "--vdb <path> [categories]" to have the
+	 * installed packages read natively. No curses are involved.
+	 */
+	if ( (argc > 2) && !strcmp(argv[1], "--vdb") )
+		return scanVdb(argv[2], argc - 3, argv + 3);
+
 	read_flags();
-	fayt     = (char*)  calloc(minwidth, sizeof(*fayt));
-	faytsave = (sFlag**)calloc(minwidth, sizeof(*faytsave));
-	if(fayt==NULL || faytsave==NULL)
+	initcurses();
+
+	// Show the frame until ufed.pl has read the flags
+	if (isStreamed) {
+		drawLoading(ro_mode ? subtitle_ro : subtitle_rw, "Reading USE flags...");
+		read_flags_list();
+		resizecurses();
+		if (flagsLoaded < flagsTotal)
+			setLoader(3, &load_flags);
+	}
+
+	fayt      = (char*)      calloc(minwidth, sizeof(*fayt));
+	faytrange = (sFaytRange*)calloc(minwidth, sizeof(*faytrange));
+	faytsave  = (int*)       calloc(minwidth, sizeof(*faytsave));
+	if(fayt==NULL || faytrange==NULL || faytsave==NULL)
 		ERROR_EXIT(-1, "Unable to allocate %lu bytes for search buffer.\n",
-			(minwidth * sizeof(*fayt)) + (minwidth * sizeof(*faytsave)));
+			(minwidth * sizeof(*fayt)) + (minwidth * sizeof(*faytrange))
+			+ (minwidth * sizeof(*faytsave)));
 	fayt[0] = '\0';
 
-	initcurses();
-
 	/* Some notes on the keys:
 	 * - The key '\0' (or simply 0) stops the processing of the
 	 * array. This means, templates or future keys can be added
@@ -842,14 +1298,18 @@ int main(void)
 	};
 
 	result = maineventloop(ro_mode ? subtitle_ro : subtitle_rw,
-				&callback, &drawflag, flags, keys, true);
+				&callback, &drawflag, &flags, keys, true);
+
+	// Flags that are not read, yet, must be written back, too.
+	if ( (0 == result) && isStreamed )
+		while (load_flags()) ;
 
 	cursesdone();
 
 	if(0 == result) {
 		FILE *output = fdopen(4, "w");
-		sFlag *flag = flags;
-		do {
+		for (int i = 0; i < flags.count; ++i) {
+			sFlag *flag = &flags.flag[i];
 			switch(flag->stateConf)
 			{
 			case '+':
@@ -859,13 +1319,13 @@ int main(void)
 				fprintf(output, "-%s\n", flag->name);
 				break;
 			}
-			flag = flag->next;
-		} while(flag != flags);
+		}
 		fclose(output);
 	}
 
-	if (fayt)     free(fayt);
-	if (faytsave) free(faytsave);
+	if (fayt)      free(fayt);
+	if (faytrange) free(faytrange);
+	if (faytsave)  free(faytsave);
 
 	return result;
 }
@@ -19,7 +19,8 @@ eScope     e_scope        = eScope_all;
 eState     e_state        = eState_all;
 eWrap      e_wrap         = eWrap_normal;
 char*      fayt           = NULL;
-sListStats listStats      = { 0, 0, 0, 0, 0, 0 };
+int        flagsLoaded    = 0;
+int        flagsTotal     = 0;
 // windows: top, left, height width
 sWindow    window[wCount] = {
 	{ NULL,  0,  0,   4,  0 }, /* Top       --- Top ---- */
@@ -19,7 +19,8 @@ extern eScope     e_scope;
 extern eState     e_state;
 extern eWrap      e_wrap;
 extern char*      fayt;
-extern sListStats listStats;
+extern int        flagsLoaded;
+extern int        flagsTotal;
 extern int        minwidth;
 extern bool       ro_mode;
 extern int        topline;
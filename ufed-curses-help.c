@@ -12,12 +12,12 @@
 
 
 /* internal members */
-static sFlag* lines = NULL;
+static sFlagList lines = { 0, NULL, 0 };
 static size_t helpheight, helpwidth;
 
 /* internal prototypes */
-static int callback(sFlag** curr, int key);
-static int drawline(sFlag* line, bool highlight);
+static int callback(int* curr, int key);
+static void drawline(sFlag* line, int y, const sRow* row, int count, bool highlight);
 static void free_lines(void);
 void help(void);
 static void init_lines(void);
@@ -125,7 +125,15 @@ static void init_lines(void)
 "display to wrap long lines into multiple lines using the F11 key.",
 "",
 "Use the Up and Down arrow keys, the Page Up and Page Down keys, the Home and "
-"End keys, or start typing the name of a flag to select it.",
+"End keys, or start typing the name of a flag to select it. The Tab key then "
+"selects the next flag starting with what you typed.",
+"Press / to search the flag names, descriptions and package lists for a text. "
+"The search is done while you type, and the best match is selected: a flag "
+"named like the text, then flags with names starting with or containing it, "
+"then flags described with it, and last flags with all its characters in "
+"their names in order. Enter keeps the search and ESC ends it. Tab and "
+"Shift+Tab then select the next and previous flag found, and the matches in "
+"the descriptions are marked.",
 "Use the space bar to toggle the setting.",
 "",
 "You can apply various filters on the flags to display. The text of the bottom "
@@ -314,6 +322,7 @@ static void init_lines(void)
 			addFlagDesc(line, NULL, buf, NULL, "+      ");
 		} else
 			addFlagDesc(line, NULL, " ", NULL, "+      ");
+		genFlagStats(line);
 
 		// Advance behind current spaces
 		while (word[n] == ' ')
@@ -330,24 +339,21 @@ static void init_lines(void)
 
 static void free_lines(void)
 {
-	sFlag* line = lines->prev;
-
-	// Clear all lines
-	while (lines) {
-		if (line)
-			destroyFlag(&lines, &line);
-		else
-			destroyFlag(&lines, &lines);
-		line = lines ? lines->prev ? lines->prev : lines : NULL;
-	}
+	destroyFlagList(&lines);
 }
 
 
-static int drawline(sFlag* line, bool highlight)
+/* Help lines are already wrapped and shown without any filter,
+ * so every line has exactly one row.
+ */
+static void drawline(sFlag* line, int y, const sRow* row, int count, bool highlight)
 {
 	char buf[wWidth(List)+1];
 
-	sprintf(buf, "%-*.*s", wWidth(List), wWidth(List), line->desc[0].desc);
+	if (count < 1)
+		return;
+
+	sprintf(buf, "%-*.*s", wWidth(List), wWidth(List), line->desc[row->desc].desc);
 
 	if ('-' == buf[0]) {
 		if (highlight)
@@ -361,14 +367,13 @@ static int drawline(sFlag* line, bool highlight)
 			wattrset(win(List), COLOR_PAIR(3));
 	}
 
-	mvwaddstr(win(List), line->currline, 0, buf);
+	mvwaddstr(win(List), y, 0, buf);
 	if(highlight)
-		wmove(win(List), line->currline, 0);
+		wmove(win(List), y, 0);
 	wnoutrefresh(win(List));
-	return 1;
 }
 
-static int callback(sFlag** curr, int key)
+static int callback(int* curr, int key)
 {
 	switch(key) {
 		case 'Q': case 'q':
@@ -378,7 +383,7 @@ static int callback(sFlag** curr, int key)
 		case KEY_RESIZE:
 			free_lines();
 			init_lines();
-			*curr = lines;
+			*curr = 0;
 			return -2;
 #endif
 		default:
@@ -395,12 +400,12 @@ void help(void)
 
 	if ( ((int)helpheight != wHeight(List))
 	  || ((int)helpwidth  != wWidth(List)) ) {
-		if(lines!=NULL)
+		if(lines.count)
 			free_lines();
 		init_lines();
 	}
 
 	int oldVis = curs_set(0);
-	maineventloop("", &callback, &drawline, lines, keys, false);
+	maineventloop("", &callback, &drawline, &lines, keys, false);
 	curs_set(oldVis);
 }
@@ -0,0 +1,178 @@
+/*
+ * ufed-curses-legality-test.c
+ *
+ *  Check the precomputed filter legality masks against the plain filter rules
+ */
+
+#include "ufed-curses.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/// @brief number of states a description can have, see setDescState()
+#define DESC_STATES 36
+
+
+/* internal prototypes */
+static bool isDescLegalRef(const sFlag* flag, int idx);
+static void setDescState(char state[7], int num);
+
+
+/* stubs of what ERROR_EXIT() needs */
+void cursesdone(void) {}
+
+
+/** @brief check isDescLegal() and isFlagLegal() of all description states
+ *  Every flag gets a first description and, except for the flags with a
+ *  single description, a second one. Both walk through all states, so
+ *  genFlagStats() derives every combination of globalMasked and
+ *  globalForced it can produce. The masks are then compared with the
+ *  rules isDescLegal() evaluated before they were precomputed, for every
+ *  combination of e_scope, e_state and e_mask. Finally all possible
+ *  description states must have been checked.
+**/
+int main(void)
+{
+	char       name[]     = "flag";
+	int        checked    = 0;
+	int        failed     = 0;
+	sFlagList  list       = { 0, NULL, 0 };
+	bool       reached[2][2][2][2][3][3] = { { { { { { false } } } } } };
+	const char marks[]    = "+- ";
+
+	for (int first = 0; first < DESC_STATES; ++first) {
+		for (int second = -1; second < DESC_STATES; ++second) {
+			char   state[7];
+			int    ndesc = second < 0 ? 1 : 2;
+			sFlag* flag  = addFlag(&list, name, 0, ndesc, "  ");
+
+			setDescState(state, first);
+			addFlagDesc(flag, NULL, "first", "first", state);
+			if (second >= 0) {
+				setDescState(state, second);
+				addFlagDesc(flag, "cat/pkg", "second", "second", state);
+			}
+			genFlagStats(flag);
+
+			for (e_scope = eScope_all; e_scope <= eScope_local; ++e_scope) {
+				for (e_state = eState_all; e_state <= eState_notinstalled; ++e_state) {
+					for (e_mask = eMask_unmasked; e_mask <= eMask_both; ++e_mask) {
+						bool anyLegal = false;
+
+						for (int i = 0; i < ndesc; ++i) {
+							const sDesc* desc = &flag->desc[i];
+							bool         ref  = isDescLegalRef(flag, i);
+
+							anyLegal = anyLegal || ref;
+							reached[desc->isGlobal][desc->isInstalled]
+							       [flag->globalMasked][flag->globalForced]
+							       [strchr(marks, desc->stateMasked) - marks]
+							       [strchr(marks, desc->stateForced) - marks] = true;
+
+							++checked;
+							if (ref != isDescLegal(flag, i)) {
+								++failed;
+								fprintf(stderr, "isDescLegal() is %d for states %d/%d,"
+									" description %d, scope %d, state %d, mask %d\n",
+									!ref, first, second, i, e_scope, e_state, e_mask);
+							}
+						}
+
+						++checked;
+						if (anyLegal != isFlagLegal(flag)) {
+							++failed;
+							fprintf(stderr, "isFlagLegal() is %d for states %d/%d,"
+								" scope %d, state %d, mask %d\n",
+								!anyLegal, first, second, e_scope, e_state, e_mask);
+						}
+					}
+				}
+			}
+		}
+	}
+
+	// A global description enabling use.mask or use.force always sets
+	// globalMasked or globalForced, every other combination must be reached.
+	int combinations = 0;
+	for (int g = 0; g < 2; ++g) {
+		for (int in = 0; in < 2; ++in) {
+			for (int gm = 0; gm < 2; ++gm) {
+				for (int gf = 0; gf < 2; ++gf) {
+					for (int sm = 0; sm < 3; ++sm) {
+						for (int sf = 0; sf < 3; ++sf) {
+							bool possible = !g || ((gm || ('+' != marks[sm]))
+							                    && (gf || ('+' != marks[sf])));
+							if (reached[g][in][gm][gf][sm][sf])
+								++combinations;
+							else if (possible) {
+								++failed;
+								fprintf(stderr, "No description with isGlobal %d, isInstalled %d,"
+									" globalMasked %d, globalForced %d, stateMasked '%c',"
+									" stateForced '%c' was checked\n",
+									g, in, gm, gf, marks[sm], marks[sf]);
+							}
+						}
+					}
+				}
+			}
+		}
+	}
+
+	printf("%d checks, %d failed, %d description state combinations reached\n",
+		checked, failed, combinations);
+
+	destroyFlagList(&list);
+
+	return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+
+/** @brief the filter rules as isDescLegal() evaluated them for each call
+ *  This is the reference the precomputed masks have to match.
+**/
+static bool isDescLegalRef(const sFlag* flag, int idx)
+{
+	bool result = false;
+
+	if (flag && (idx < flag->ndesc)) {
+		if ( // 1.: Check isGlobal versus e_scope
+			 ( ( flag->desc[idx].isGlobal && (e_scope != eScope_local))
+			|| (!flag->desc[idx].isGlobal && (e_scope != eScope_global)) )
+			 // 2.: Check isInstalled versus e_state
+		  && ( ( flag->desc[idx].isInstalled && (e_state != eState_notinstalled))
+			|| (!flag->desc[idx].isInstalled && (e_state != eState_installed)) )
+			 // 3.: Check stateForced/stateMasked versus e_mask
+		  && ( ( (e_mask != eMask_unmasked)
+			  && ( (flag->globalMasked && ('-' != flag->desc[idx].stateMasked))
+				|| ('+' == flag->desc[idx].stateMasked)
+			    || (flag->globalForced && ('-' != flag->desc[idx].stateForced))
+				|| ('+' == flag->desc[idx].stateForced) ) )
+		    || ( (e_mask != eMask_masked)
+			  && ( (!flag->globalMasked && ('+' != flag->desc[idx].stateMasked))
+				|| ('-' == flag->desc[idx].stateMasked) )
+			  && ( (!flag->globalForced && ('+' != flag->desc[idx].stateForced))
+				|| ('-' == flag->desc[idx].stateForced) ) ) ) )
+			result = true;
+	}
+
+	return result;
+}
+
+
+/** @brief fill the state string of addFlagDesc() for description state @a num
+ *  The DESC_STATES states are all combinations of global or local,
+ *  installed or not, and '+', '-' or ' ' for masked and forced.
+**/
+static void setDescState(char state[7], int num)
+{
+	const char marks[] = "+- ";
+
+	state[0] = num & 1 ? '+' : '-';     // global
+	state[1] = num & 2 ? '+' : '-';     // installed
+	state[2] = marks[(num / 4) % 3];    // forced
+	state[3] = marks[(num / 12) % 3];   // masked
+	state[4] = ' ';                     // default
+	state[5] = ' ';                     // package
+	state[6] = ' ';                     // package.use
+}
@@ -0,0 +1,711 @@
+/*
+ * ufed-curses-search.c
+ *
+ *  Full text search over the names, descriptions and package lists of the flags
+ */
+
+#include "ufed-curses-search.h"
+#include "ufed-curses.h"
+
+#include <ctype.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <unistd.h>
+
+/** @brief number of different trigram keys, see getGramKey()
+ *  Each character is folded into one of 64 symbols.
+**/
+#define GRAM_KEYS (1 << 18)
+
+/** @brief number of flags the worker searches before it posts its hits
+ *  Between two chunks the worker also notices if its query is stale.
+**/
+#define SEARCH_CHUNK_SIZE 512
+
+
+/* internal types */
+
+/** @enum eRank_
+ *  @brief how well a hit matches, lower is better
+**/
+typedef enum eRank_ {
+	eRank_exact = 0, //!< the name is the search text
+	eRank_prefix,    //!< the name starts with the search text
+	eRank_name,      //!< the name contains the search text
+	eRank_desc,      //!< a description or package list contains the search text
+	eRank_fuzzy      //!< the name contains the characters of the search text in order
+} eRank;
+
+
+/** @struct sSearchHit_
+ *  @brief one name or description the search text was found in
+**/
+typedef struct sSearchHit_ {
+	int   desc; //!< index of the description in its flag, -1 for the flag name
+	int   flag; //!< index of the flag in its table
+	eRank rank; //!< how well the hit matches
+} sSearchHit;
+
+
+/** @struct sHitList_
+ *  @brief growing array of hits in list order
+**/
+typedef struct sHitList_ {
+	int         count; //!< number of hits
+	sSearchHit* hit;   //!< the hits
+	int         size;  //!< number of hits allocated
+} sHitList;
+
+
+/* internal members */
+
+// Owned by the worker thread
+static int*            descBase    = NULL;  //!< number of the first description of each flag, flagCount + 1 entries
+static int             flagCount   = 0;     //!< number of flags indexed
+static sHitList        found       = { 0, NULL, 0 }; //!< hits not posted, yet
+static int*            gramDoc     = NULL;  //!< numbers of the descriptions containing each trigram, ascending
+static int*            gramStart   = NULL;  //!< start of the descriptions of each key in gramDoc, GRAM_KEYS + 1 entries
+
+// Shared, guarded by searchLock
+static bool            isBusy      = false; //!< the worker is searching
+static bool            isDone      = true;  //!< all hits of the current query are posted
+static bool            isQuit      = false; //!< the worker has to end
+static bool            isSignalled = false; //!< a byte is waiting in the wakeup pipe
+static const
+       sFlagList*      pendList    = NULL;  //!< the list to search for pendText
+static char*           pendText    = NULL;  //!< query waiting for the worker, if any
+static sHitList        posted      = { 0, NULL, 0 }; //!< hits of the current query not read, yet
+static int             queryGen    = 0;     //!< number of the current query, hits of older ones are dropped
+static pthread_cond_t  searchCond  = PTHREAD_COND_INITIALIZER;
+static pthread_mutex_t searchLock  = PTHREAD_MUTEX_INITIALIZER;
+
+// Owned by the UI thread
+static bool            hasWorker   = false;
+static sHitList        hits        = { 0, NULL, 0 }; //!< the hits read, in list order
+static char*           query       = NULL;  //!< the text searched for, NULL if there is none
+static int             wakeFd[2]   = { -1, -1 }; //!< wakeup pipe, the worker writes, the UI polls
+static pthread_t       worker;
+
+/* internal prototypes */
+static void        addGrams    (const char* text, int doc, int* last, int* slot, int* out);
+static void        addHit      (sHitList* list, int flag, int desc, eRank rank);
+static void        buildIndex  (const sFlagList* list);
+static int         findFirstHit(int flag);
+static const char* findFolded  (const char* text, const char* what);
+static int         getNameRank (const char* name, const char* text, size_t len);
+static bool        hasDoc      (int key, int doc);
+static bool        isHitLegal  (const sFlagList* list, const sSearchHit* hit);
+static bool        postHits    (sHitList* batch, int gen, bool isLast);
+static void        runSearch   (const sFlagList* list, const char* text, int gen);
+static void*       searchWorker(void* unused);
+static void        startWorker (void);
+
+/* internal inline functions */
+/// @brief fold @a c into one of 64 symbols, letters and digits keep their own
+static inline int getGramSymbol(char c)
+{
+	int s = tolower((unsigned char)c);
+	if ( (s >= 'a') && (s <= 'z') )
+		return s - 'a' + 1;
+	if ( (s >= '0') && (s <= '9') )
+		return s - '0' + 27;
+	return 37 + (s % 27);
+}
+/// @brief the key of the trigram starting at @a text
+static inline int getGramKey(const char* text)
+{
+	return (getGramSymbol(text[0]) << 12) | (getGramSymbol(text[1]) << 6) | getGramSymbol(text[2]);
+}
+
+
+/* function implementations */
+
+/** @brief end the worker and free the search index and the results
+**/
+void destroySearch()
+{
+	if (hasWorker) {
+		pthread_mutex_lock(&searchLock);
+		isQuit = true;
+		pthread_cond_broadcast(&searchCond);
+		pthread_mutex_unlock(&searchLock);
+		pthread_join(worker, NULL);
+	}
+	if (wakeFd[0] >= 0) {
+		close(wakeFd[0]);
+		close(wakeFd[1]);
+	}
+
+	if (descBase)   free(descBase);
+	if (found.hit)  free(found.hit);
+	if (gramDoc)    free(gramDoc);
+	if (gramStart)  free(gramStart);
+	if (hits.hit)   free(hits.hit);
+	if (pendText)   free(pendText);
+	if (posted.hit) free(posted.hit);
+	if (query)      free(query);
+	descBase     = NULL;
+	flagCount    = 0;
+	found.count  = 0;
+	found.hit    = NULL;
+	found.size   = 0;
+	gramDoc      = NULL;
+	gramStart    = NULL;
+	hasWorker    = false;
+	hits.count   = 0;
+	hits.hit     = NULL;
+	hits.size    = 0;
+	isBusy       = false;
+	isDone       = true;
+	isQuit       = false;
+	isSignalled  = false;
+	pendList     = NULL;
+	pendText     = NULL;
+	posted.count = 0;
+	posted.hit   = NULL;
+	posted.size  = 0;
+	query        = NULL;
+	wakeFd[0]    = -1;
+	wakeFd[1]    = -1;
+}
+
+
+/** @brief find the legal flag from @a start on with the best ranked hit read so far
+ *  Hits in flag names rank before hits in descriptions, and those before
+ *  names that only contain the characters of the search text. Of equally
+ *  ranked flags the first from @a start on is taken, wrapping around at
+ *  the end of the list.
+ *  @param[in] list the flags searched by startSearch().
+ *  @param[in] start index of the flag to start with.
+ *  @return the index of the flag found or -1 if there is none.
+**/
+int findBestFound(const sFlagList* list, int start)
+{
+	const sSearchHit* best  = NULL;
+	int               first = 0;
+
+	if (!hits.count || !list->count)
+		return -1;
+
+	first = findFirstHit((start >= 0) && (start < list->count) ? start : 0);
+	for (int n = 0; n < hits.count; ++n) {
+		const sSearchHit* hit = &hits.hit[(first + n) % hits.count];
+		if ( (!best || (hit->rank < best->rank))
+		  && isHitLegal(list, hit) )
+			best = hit;
+	}
+
+	return best ? best->flag : -1;
+}
+
+
+/** @brief find the first flag from @a start on with a hit read so far
+ *  The search wraps around at the ends of the list. Hits that are
+ *  hidden by the current filters are skipped.
+ *  @param[in] list the flags searched by startSearch().
+ *  @param[in] start index of the flag to start with, may be one off either end.
+ *  @param[in] forward true to search downwards, false to search upwards.
+ *  @return the index of the flag found or -1 if there is none.
+**/
+int findNextFound(const sFlagList* list, int start, bool forward)
+{
+	int first = 0;
+
+	if (!hits.count || !list->count)
+		return -1;
+
+	if (start >= list->count)
+		start = 0;
+	else if (start < 0)
+		start = list->count - 1;
+
+	// first hit of a flag from start on, or the last one up to start
+	if (forward)
+		first = findFirstHit(start);
+	else
+		first = findFirstHit(start + 1) - 1 + hits.count;
+
+	for (int n = 0; n < hits.count; ++n) {
+		const sSearchHit* hit = &hits.hit[(forward ? first + n : first - n) % hits.count];
+		if (isHitLegal(list, hit))
+			return hit->flag;
+	}
+
+	return -1;
+}
+
+
+/** @brief find the text of the last search in @a text, ignoring case
+ *  @return pointer to the first match in @a text, or NULL if there is
+ *  none or no search is active.
+**/
+const char* findQuery(const char* text)
+{
+	if (query && text)
+		return findFolded(text, query);
+	return NULL;
+}
+
+
+/** @brief return the file descriptor that gets readable when the worker posted hits
+ *  @return the descriptor, or -1 if no search was ever started.
+**/
+int getSearchFd()
+{
+	return wakeFd[0];
+}
+
+
+/** @brief take over the hits the worker posted since the last call
+ *  This is to be called whenever getSearchFd() is readable.
+ *  @param[out] count the number of hits read so far, filtered or not.
+ *  @return true if the search is still running, false if all hits are read.
+**/
+bool readSearch(int* count)
+{
+	char drain[64];
+	bool isRunning;
+
+	// Empty the pipe before the flag is reset, so no post is missed
+	if (wakeFd[0] >= 0)
+		while (read(wakeFd[0], drain, sizeof(drain)) > 0) ;
+
+	pthread_mutex_lock(&searchLock);
+	isSignalled = false;
+	for (int i = 0; i < posted.count; ++i)
+		addHit(&hits, posted.hit[i].flag, posted.hit[i].desc, posted.hit[i].rank);
+	posted.count = 0;
+	isRunning    = !isDone;
+	pthread_mutex_unlock(&searchLock);
+
+	if (count)
+		*count = hits.count;
+
+	return isRunning;
+}
+
+
+/** @brief hand a new search for @a text in @a list over to the worker
+ *  The search of the previous text is dropped, and its hits are
+ *  forgotten. The names are searched for the text and for its characters
+ *  in order, the descriptions, alternative descriptions and package lists
+ *  for the text. Case is ignored. The hits are posted in chunks, see
+ *  getSearchFd() and readSearch(). An empty @a text ends the search.
+ *  @param[in] list the flags to search.
+ *  @param[in] text the text to look for.
+**/
+void startSearch(const sFlagList* list, const char* text)
+{
+	size_t len = text ? strlen(text) : 0;
+
+	if (query)
+		free(query);
+	query      = NULL;
+	hits.count = 0;
+
+	if (len) {
+		query = strdup(text);
+		if (NULL == query)
+			ERROR_EXIT(-1, "Unable to allocate %lu bytes for search text\n", len + 1)
+		if (!hasWorker)
+			startWorker();
+	}
+
+	pthread_mutex_lock(&searchLock);
+	++queryGen;
+	if (pendText)
+		free(pendText);
+	pendList     = list;
+	pendText     = len ? strdup(text) : NULL;
+	posted.count = 0;
+	isDone       = !len;
+	if (len && (NULL == pendText))
+		ERROR_EXIT(-1, "Unable to allocate %lu bytes for search text\n", len + 1)
+	pthread_cond_broadcast(&searchCond);
+	pthread_mutex_unlock(&searchLock);
+
+	// Without a worker thread, the UI thread has to do the work itself
+	if (len && (wakeFd[1] >= 0) && !hasWorker) {
+		char* own = pendText;
+		pendText  = NULL;
+		runSearch(list, own, queryGen);
+		free(own);
+	}
+}
+
+
+/** @brief wait until the worker is done with the current search
+ *  This must be called before the searched list is changed.
+ *  The hits are left to readSearch().
+**/
+void waitSearch()
+{
+	if (!hasWorker)
+		return;
+
+	pthread_mutex_lock(&searchLock);
+	while (pendText || isBusy)
+		pthread_cond_wait(&searchCond, &searchLock);
+	pthread_mutex_unlock(&searchLock);
+}
+
+
+/* internal function implementations */
+
+/** @brief count or note the trigrams of @a text for description @a doc
+ *  Each key is only taken once per description, @a last notes the
+ *  description a key was last taken for. If @a out is NULL, the keys
+ *  are counted in @a slot, otherwise @a doc is written to @a out at
+ *  @a slot, which is advanced.
+**/
+static void addGrams(const char* text, int doc, int* last, int* slot, int* out)
+{
+	size_t len = text ? strlen(text) : 0;
+
+	for (size_t i = 0; (i + 3) <= len; ++i) {
+		int key = getGramKey(text + i);
+		if (last[key] != doc) {
+			last[key] = doc;
+			if (out)
+				out[slot[key]++] = doc;
+			else
+				++slot[key];
+		}
+	}
+}
+
+
+/** @brief append a hit in description @a desc of flag @a flag to @a list
+**/
+static void addHit(sHitList* list, int flag, int desc, eRank rank)
+{
+	if (list->count == list->size) {
+		int         newSize = max(list->size * 2, 64);
+		sSearchHit* newHits = (sSearchHit*)realloc(list->hit, sizeof(sSearchHit) * newSize);
+		if (NULL == newHits)
+			ERROR_EXIT(-1, "Unable to allocate %lu bytes for search results\n",
+				sizeof(sSearchHit) * newSize)
+		list->hit  = newHits;
+		list->size = newSize;
+	}
+	list->hit[list->count].desc = desc;
+	list->hit[list->count].flag = flag;
+	list->hit[list->count].rank = rank;
+	++list->count;
+}
+
+
+/** @brief build the trigram index of all descriptions of @a list
+ *  The descriptions are numbered in list order. For each trigram key
+ *  the numbers of the descriptions containing it are stored in
+ *  ascending order. Two passes over the texts are made, the first
+ *  counts, the second fills in.
+**/
+static void buildIndex(const sFlagList* list)
+{
+	int* last  = (int*)malloc(sizeof(int) * GRAM_KEYS);
+	int* slot  = (int*)calloc(GRAM_KEYS, sizeof(int));
+	int* base  = (int*)realloc(descBase, sizeof(int) * (list->count + 1));
+	int* start = (int*)realloc(gramStart, sizeof(int) * (GRAM_KEYS + 1));
+
+	if ( (NULL == last) || (NULL == slot) || (NULL == base) || (NULL == start) )
+		ERROR_EXIT(-1, "Unable to allocate %lu bytes for search index\n",
+			sizeof(int) * (3 * GRAM_KEYS + list->count + 2))
+	descBase  = base;
+	gramStart = start;
+	flagCount = list->count;
+
+	// Pass 1: number the descriptions and count the keys
+	memset(last, 0xff, sizeof(int) * GRAM_KEYS);
+	descBase[0] = 0;
+	for (int i = 0; i < flagCount; ++i) {
+		const sFlag* flag = &list->flag[i];
+		for (int j = 0; j < flag->ndesc; ++j) {
+			int doc = descBase[i] + j;
+			addGrams(flag->desc[j].desc,     doc, last, slot, NULL);
+			addGrams(flag->desc[j].desc_alt, doc, last, slot, NULL);
+			addGrams(flag->desc[j].pkg,      doc, last, slot, NULL);
+		}
+		descBase[i + 1] = descBase[i] + flag->ndesc;
+	}
+
+	// Turn the counts into start positions
+	gramStart[0] = 0;
+	for (int k = 0; k < GRAM_KEYS; ++k) {
+		gramStart[k + 1] = gramStart[k] + slot[k];
+		slot[k]          = gramStart[k];
+	}
+
+	int* docs = (int*)realloc(gramDoc, sizeof(int) * (gramStart[GRAM_KEYS] + 1));
+	if (NULL == docs)
+		ERROR_EXIT(-1, "Unable to allocate %lu bytes for search index\n",
+			sizeof(int) * (gramStart[GRAM_KEYS] + 1))
+	gramDoc = docs;
+
+	// Pass 2: fill in the description numbers
+	memset(last, 0xff, sizeof(int) * GRAM_KEYS);
+	for (int i = 0; i < flagCount; ++i) {
+		const sFlag* flag = &list->flag[i];
+		for (int j = 0; j < flag->ndesc; ++j) {
+			int doc = descBase[i] + j;
+			addGrams(flag->desc[j].desc,     doc, last, slot, gramDoc);
+			addGrams(flag->desc[j].desc_alt, doc, last, slot, gramDoc);
+			addGrams(flag->desc[j].pkg,      doc, last, slot, gramDoc);
+		}
+	}
+
+	free(last);
+	free(slot);
+}
+
+
+/** @brief return the position of the first hit read of flag @a flag or a later one
+**/
+static int findFirstHit(int flag)
+{
+	int first = 0;
+
+	for (int n = hits.count; n > 0; ) {
+		int half = n / 2;
+		if (hits.hit[first + half].flag < flag) {
+			first += half + 1;
+			n     -= half + 1;
+		} else
+			n = half;
+	}
+
+	return first;
+}
+
+
+/** @brief find @a what in @a text ignoring case
+ *  @return pointer to the first match in @a text or NULL.
+**/
+static const char* findFolded(const char* text, const char* what)
+{
+	for ( ; *text; ++text) {
+		size_t i = 0;
+		while ( what[i]
+		     && (tolower((unsigned char)text[i]) == tolower((unsigned char)what[i])) )
+			++i;
+		if (!what[i])
+			return text;
+	}
+
+	return NULL;
+}
+
+
+/** @brief rank flag name @a name against the search text @a text of length @a len
+ *  @return the rank of the hit, or -1 if the name does not match.
+**/
+static int getNameRank(const char* name, const char* text, size_t len)
+{
+	if (!strcasecmp(name, text))
+		return eRank_exact;
+	if (!strncasecmp(name, text, len))
+		return eRank_prefix;
+	if (findFolded(name, text))
+		return eRank_name;
+
+	// A single character would match far too much
+	if (len < 2)
+		return -1;
+	while (*text && *name) {
+		if (tolower((unsigned char)*name) == tolower((unsigned char)*text))
+			++text;
+		++name;
+	}
+
+	return *text ? -1 : eRank_fuzzy;
+}
+
+
+/** @brief return true if description @a doc contains trigram @a key
+**/
+static bool hasDoc(int key, int doc)
+{
+	int lo = gramStart[key];
+	int hi = gramStart[key + 1];
+
+	while (lo < hi) {
+		int mid = lo + (hi - lo) / 2;
+		if (gramDoc[mid] < doc)
+			lo = mid + 1;
+		else if (gramDoc[mid] > doc)
+			hi = mid;
+		else
+			return true;
+	}
+
+	return false;
+}
+
+
+/// @brief return true if @a hit is in @a list and shown with the current filters
+static bool isHitLegal(const sFlagList* list, const sSearchHit* hit)
+{
+	if (hit->flag >= list->count)
+		return false;
+	if (hit->desc < 0)
+		return isFlagLegal(&list->flag[hit->flag]);
+	return isDescLegal(&list->flag[hit->flag], hit->desc);
+}
+
+
+/** @brief post the hits in @a batch for query @a gen to the UI thread
+ *  The UI thread is woken up through the pipe, unless it has not read
+ *  the last post, yet. @a batch is emptied.
+ *  @param[in,out] batch the hits found since the last post.
+ *  @param[in] gen the number of the query searched for.
+ *  @param[in] isLast true if the search is done with these.
+ *  @return false if the query is stale and the search should stop.
+**/
+static bool postHits(sHitList* batch, int gen, bool isLast)
+{
+	bool isCurrent;
+
+	pthread_mutex_lock(&searchLock);
+	isCurrent = (gen == queryGen);
+	if (isCurrent && (batch->count || isLast)) {
+		for (int i = 0; i < batch->count; ++i)
+			addHit(&posted, batch->hit[i].flag, batch->hit[i].desc, batch->hit[i].rank);
+		isDone = isLast;
+		if (!isSignalled) {
+			char wake = 1;
+			isSignalled = (1 == write(wakeFd[1], &wake, 1));
+		}
+	}
+	pthread_mutex_unlock(&searchLock);
+
+	batch->count = 0;
+
+	return isCurrent;
+}
+
+
+/** @brief search @a list for @a text and post the hits, see startSearch()
+ *  The flags are searched in list order, so the hits are posted in list
+ *  order, too. The trigram index is built first if the list has grown
+ *  since. The descriptions are taken from those of the rarest trigram of
+ *  @a text, or all of them for short texts, and only those having every
+ *  trigram of @a text are compared.
+ *  @param[in] list the flags to search.
+ *  @param[in] text the text to look for.
+ *  @param[in] gen the number of the query, the search stops once it is stale.
+**/
+static void runSearch(const sFlagList* list, const char* text, int gen)
+{
+	size_t len = strlen(text);
+
+	if (flagCount != list->count)
+		buildIndex(list);
+
+	int docCount = descBase[flagCount];
+	int lo       = 0;
+	int hi       = docCount;
+	int rarest   = -1;
+
+	// Candidates are the descriptions of the rarest trigram, or all of them
+	for (size_t i = 0; (i + 3) <= len; ++i) {
+		int key = getGramKey(text + i);
+		if ( (rarest < 0)
+		  || ((gramStart[key + 1] - gramStart[key]) < (hi - lo)) ) {
+			rarest = key;
+			lo     = gramStart[key];
+			hi     = gramStart[key + 1];
+		}
+	}
+
+	found.count = 0;
+	for (int flag = 0, next = lo; flag < flagCount; ++flag) {
+		const sFlag* pFlag = &list->flag[flag];
+
+		if ( flag && !(flag % SEARCH_CHUNK_SIZE)
+		  && !postHits(&found, gen, false) )
+			return;
+
+		int rank = getNameRank(pFlag->name, text, len);
+		if (rank >= 0)
+			addHit(&found, flag, -1, (eRank)rank);
+
+		// The candidates of this flag
+		for ( ; next < hi; ++next) {
+			int  doc         = rarest < 0 ? next : gramDoc[next];
+			bool isCandidate = true;
+
+			if (doc >= descBase[flag + 1])
+				break;
+
+			for (size_t j = 0; isCandidate && ((j + 3) <= len); ++j)
+				isCandidate = hasDoc(getGramKey(text + j), doc);
+			if (!isCandidate)
+				continue;
+
+			const sDesc* desc = &pFlag->desc[doc - descBase[flag]];
+			if ( (desc->desc     && findFolded(desc->desc,     text))
+			  || (desc->desc_alt && findFolded(desc->desc_alt, text))
+			  || (desc->pkg      && findFolded(desc->pkg,      text)) )
+				addHit(&found, flag, doc - descBase[flag], eRank_desc);
+		}
+	}
+
+	postHits(&found, gen, true);
+}
+
+
+/** @brief search every query handed over by startSearch() until destroySearch() is called
+ *  This is the thread function of the worker.
+**/
+static void* searchWorker(void* unused)
+{
+	(void)unused;
+
+	pthread_mutex_lock(&searchLock);
+	for (;;) {
+		while (!isQuit && !pendText)
+			pthread_cond_wait(&searchCond, &searchLock);
+		if (isQuit)
+			break;
+
+		const sFlagList* list = pendList;
+		char*            text = pendText;
+		int              gen  = queryGen;
+		pendText = NULL;
+		isBusy   = true;
+		pthread_mutex_unlock(&searchLock);
+
+		runSearch(list, text, gen);
+		free(text);
+
+		pthread_mutex_lock(&searchLock);
+		isBusy = false;
+		pthread_cond_broadcast(&searchCond);
+	}
+	pthread_mutex_unlock(&searchLock);
+
+	return NULL;
+}
+
+
+/** @brief open the wakeup pipe and start the worker thread
+ *  If the thread can not be started, startSearch() searches in the UI
+ *  thread. Without the pipe, there is no search at all.
+**/
+static void startWorker()
+{
+	if (wakeFd[0] < 0) {
+		if (pipe(wakeFd))
+			ERROR_EXIT(-1, "Unable to create search pipe, error %d\n", errno)
+		for (int i = 0; i < 2; ++i) {
+			fcntl(wakeFd[i], F_SETFL, fcntl(wakeFd[i], F_GETFL) | O_NONBLOCK);
+			fcntl(wakeFd[i], F_SETFD, FD_CLOEXEC);
+		}
+	}
+
+	hasWorker = (0 == pthread_create(&worker, NULL, searchWorker, NULL));
+}
@@ -0,0 +1,16 @@
+#pragma once
+#ifndef UFED_CURSES_SEARCH_H_INCLUDED
+#define UFED_CURSES_SEARCH_H_INCLUDED
+
+#include "ufed-curses-types.h"
+
+void        destroySearch(void);
+int         findBestFound(const sFlagList* list, int start);
+int         findNextFound(const sFlagList* list, int start, bool forward);
+const char* findQuery    (const char* text);
+int         getSearchFd  (void);
+bool        readSearch   (int* count);
+void        startSearch  (const sFlagList* list, const char* text);
+void        waitSearch   (void);
+
+#endif /* UFED_CURSES_SEARCH_H_INCLUDED */
@@ -8,8 +8,12 @@
 
 #include "ufed-curses-types.h"
 #include "ufed-curses.h"
+#include <ctype.h>
+#include <pthread.h>
 #include <stdlib.h>
 #include <string.h>
+#include <strings.h>
+#include <unistd.h>
 
 /* internal zero index sentry, replaces
  * NULL argument for idx in MAKE_KEY
@@ -21,86 +25,80 @@ extern eMask  e_mask;
 extern eScope e_scope;
 extern eState e_state;
 
+/** @brief minimum size of a newly allocated arena block
+**/
+#define ARENA_BLOCK_SIZE (1 << 16)
+
+/** @brief maximum number of threads calculating wrap layouts, see wrapFlags()
+**/
+#define WRAP_MAX_WORKERS 8
+
+/** @brief number of flags a wrap worker takes at once
+**/
+#define WRAP_CHUNK_SIZE 256
+
+
+/* internal types */
+
+/** @struct sWrapBuf_
+ *  @brief memory used by one thread to calculate wrap layouts
+ *  The scratch buffer holds the parts of the layout being calculated,
+ *  until their number is known.
+**/
+typedef struct sWrapBuf_ {
+	sArena* arena;   //!< arena the layouts and their parts are allocated from
+	sWrap*  scratch; //!< array of size parts
+	int     size;    //!< number of parts the scratch buffer can hold
+} sWrapBuf;
+
+
+/* internal members */
+static sWrapBuf        wrapBuf   = { NULL, NULL, 0 }; //!< used by the UI thread, owns all layouts
+static const
+       sFlagList*      sortList  = NULL; //!< list buildNameIndex() sorts, see compareNames()
+static sFlagList*      wrapList  = NULL;
+static pthread_mutex_t wrapLock  = PTHREAD_MUTEX_INITIALIZER;
+static int             wrapNext  = 0;
+static size_t          wrapWidth = 0;
+
 /* internal prototypes of functions only used here */
-static void calculateDescWrap(sDesc* desc);
-static void destroyWrapList(sWrap* wrap);
+static void   calculateDescWrap(const sDesc* desc, sWrapLayout* layout, sWrapBuf* buf);
+static bool   calculateDescLegal(const sFlag* flag, int idx, eScope scope, eState state, eMask mask);
+static int    compareNames(const void* lhs, const void* rhs);
+static sFlag* createFlag(sFlagList* list, sArena** arena, char* name, int line, int ndesc, const char state[2]);
+static sWrapLayout* getDescWrap(sDesc* desc, sWrapBuf* buf, size_t width);
+static void*  wrapWorker(void* buf);
+
+/* internal inline functions */
+/// @brief the case folded character at @a pos of the name of flag @a idx, the name must not be shorter than @a pos
+static inline int getNameChar(const sFlagList* list, int idx, int pos) { return tolower((unsigned char)list->flag[idx].name[pos]); }
+/// @brief the bit of the active filter combination in sDesc.legal and sFlag.legal
+static inline int getFilterBit(void) { return FILTER_BIT(e_scope, e_state, e_mask); }
+/// @brief the width wrap layouts are currently calculated for
+static inline size_t getWrapWidth(void) { return wWidth(List) - (minwidth + 8); }
 
 /* function implementations */
 
 /** @brief create a new flag without description lines
  *  As this is a crucial initialization task, the function will
  *  terminate the program if an error occurs.
- *  @param[in,out] root the new item will be *root if *root is null and its previous flag otherwise.
+ *  @a name and all strings given to addFlagDesc() for this flag
+ *  are copied, and everything is freed by destroyFlagList().
+ *  @param[in,out] list the table to append the new flag to.
  *  @param[in] name the name to set, must not be NULL.
  *  @param[in] line the fixed line in the list this item starts.
  *  @param[in] ndesc number of description lines to allocate and initialize.
  *  @param[in] state '+','-',' ' for stateConf and stateDefault in that order.
  */
-sFlag* addFlag (sFlag** root, const char* name, int line, int ndesc, const char state[2])
+sFlag* addFlag (sFlagList* list, const char* name, int line, int ndesc, const char state[2])
 {
 	sFlag* newFlag = NULL;
 
-	// Exit early if root is NULL:
-	if (!root)
-		ERROR_EXIT(-1, "root must not be %s\n", "NULL")
-
 	if (name) {
-
-		// state is a byte mask. Check it first:
-		for (int i = 0; i < 2; ++i) {
-			if (('+' != state[i]) && ('-' != state[i]) && (' ' != state[i]))
-				ERROR_EXIT(-1, "Illegal character '%c' in state string at position %d\n",
-					state[i], i)
-		}
-
-		newFlag = (sFlag*)malloc(sizeof(sFlag));
-		if (newFlag) {
-			newFlag->currline     = 0;
-			newFlag->desc         = (sDesc*)malloc(sizeof(sDesc) * ndesc);
-
-			if (newFlag->desc) {
-				for (int i = 0; i < ndesc; ++i) {
-					newFlag->desc[i].desc         = NULL;
-					newFlag->desc[i].isGlobal     = false;
-					newFlag->desc[i].isInstalled  = false;
-					newFlag->desc[i].pkg          = NULL;
-					newFlag->desc[i].stateForced  = ' ';
-					newFlag->desc[i].stateMasked  = ' ';
-					newFlag->desc[i].statePackage = ' ';
-					newFlag->desc[i].wrap         = NULL;
-					newFlag->desc[i].wrapOrder    = e_order;
-					newFlag->desc[i].wrapStripped = e_desc;
-					newFlag->desc[i].wrapWidth    = 0;
-				}
-			} else
-				ERROR_EXIT(-1, "Unable to allocate %lu bytes for %d sDesc_ structs\n",
-					sizeof(sDesc) * ndesc, ndesc)
-
-			newFlag->globalForced = false;
-			newFlag->globalMasked = false;
-			newFlag->listline     = line;
-			newFlag->name         = strdup(name);
-			newFlag->ndesc        = ndesc;
-			newFlag->next         = NULL;
-			newFlag->prev         = NULL;
-			newFlag->stateConf    = state[0];
-			newFlag->stateDefault = state[1];
-
-			// Eventually put the new flag into the doubly linked ring:
-			if (*root) {
-				newFlag->next = *root;
-				newFlag->prev = (*root)->prev;
-				(*root)->prev = newFlag;
-				if (newFlag->prev)
-					newFlag->prev->next = newFlag;
-			} else {
-				newFlag->next = newFlag;
-				newFlag->prev = newFlag;
-				*root = newFlag;
-			}
-
-		} else
-			ERROR_EXIT(-1, "Unable to allocate %lu bytes for sFlag_ struct\n", sizeof(sFlag))
+		char* newName = strdup(name);
+		if (NULL == newName)
+			ERROR_EXIT(-1, "Unable to copy flag name \"%s\"\n", name)
+		newFlag = createFlag(list, NULL, newName, line, ndesc, state);
 	} else
 		ERROR_EXIT(-1, "The new flags must have a name, not %s\n", "NULL")
 
@@ -108,9 +106,33 @@ sFlag* addFlag (sFlag** root, const char* name, int line, int ndesc, const char
 }
 
 
+/** @brief create a new flag without description lines in an arena
+ *  As this is a crucial initialization task, the function will
+ *  terminate the program if an error occurs.
+ *  The description lines are taken from @a arena, and neither @a name
+ *  nor any string given to addFlagDesc() for this flag is copied. The
+ *  strings must stay valid as long as the flag exists, and the memory
+ *  is released by destroyArena().
+ *  @param[in,out] list the table to append the new flag to.
+ *  @param[in,out] arena the arena to allocate the flag from, must not be NULL.
+ *  @param[in] name the name to set, must not be NULL.
+ *  @param[in] line the fixed line in the list this item starts.
+ *  @param[in] ndesc number of description lines to allocate and initialize.
+ *  @param[in] state '+','-',' ' for stateConf and stateDefault in that order.
+ */
+sFlag* addFlagRef (sFlagList* list, sArena** arena, char* name, int line, int ndesc, const char state[2])
+{
+	if (!arena)
+		ERROR_EXIT(-1, "arena must not be %s\n", "NULL")
+
+	return createFlag(list, arena, name, line, ndesc, state);
+}
+
+
 /** @brief add a flag description line to an existing flag
  *  As this is a crucial initialization task, the function will
  *  terminate the program if an error occurs.
+ *  The strings are only copied if the flag was created by addFlag().
  *  @param[in,out] flag pointer to the flag to manipulate. Must not be NULL
  *  @param[in] pkg list of affected packages or NULL if no packages are affected
  *  @param[in] desc description line
@@ -134,9 +156,15 @@ size_t addFlagDesc (sFlag* flag, const char* pkg, const char* desc, const char*
 			}
 
 			// Now apply.
-			if (pkg)      flag->desc[idx].pkg      = strdup(pkg);
-			if (desc)     flag->desc[idx].desc     = strdup(desc);
-			if (desc_alt) flag->desc[idx].desc_alt = strdup(desc_alt);
+			if (flag->inArena) {
+				flag->desc[idx].pkg      = (char*)pkg;
+				flag->desc[idx].desc     = (char*)desc;
+				flag->desc[idx].desc_alt = (char*)desc_alt;
+			} else {
+				if (pkg)      flag->desc[idx].pkg      = strdup(pkg);
+				if (desc)     flag->desc[idx].desc     = strdup(desc);
+				if (desc_alt) flag->desc[idx].desc_alt = strdup(desc_alt);
+			}
 			if ('+' == state[0]) flag->desc[idx].isGlobal    = true;
 			if ('+' == state[1]) flag->desc[idx].isInstalled = true;
 			flag->desc[idx].stateForced  = state[2];
@@ -165,92 +193,275 @@ size_t addFlagDesc (sFlag* flag, const char* pkg, const char* desc, const char*
 }
 
 
-/** @brief add statistics to @a stats according to the given flag stats
- *  This function simply counts how many lines are added in which filter case.
- *  @param[in] flag pointer to the flag to analyze.
- *  @param[out] stats pointer to the sListStats struct to update.
- */
-void addLineStats (const sFlag* flag, sListStats* stats)
+/** @brief append the visible lines of @a flag to @a table
+ *  Every not filtered description adds one row, or one row per
+ *  wrapped part if descriptions are wrapped.
+ *  @param[in,out] table the row table to extend.
+ *  @param[in] flag the flag to add, its wrapped parts are recalculated if needed.
+ *  @param[in] idx the index of @a flag in its table.
+ *  @return the number of rows added, which is the visible height of the flag.
+**/
+int addFlagRows (sRowTable* table, const sFlag* flag, int idx)
 {
-	if (flag && stats) {
-		for (int i = 0; i < flag->ndesc; ++i) {
-			if ( isDescMasked(flag, i) ) {
-				if (flag->desc[i].isInstalled)
-					++stats->lineCountMaskedInstalled;
-				else
-					++stats->lineCountMasked;
-			} else if (flag->desc[i].isGlobal) {
-				if (flag->desc[i].isInstalled)
-					++stats->lineCountGlobalInstalled;
-				else
-					++stats->lineCountGlobal;
-			} else {
-				if (flag->desc[i].isInstalled)
-					++stats->lineCountLocalInstalled;
-				else
-					++stats->lineCountLocal;
+	int height = getFlagHeight(flag); // Will recalculate wrap parts if needed
+	int result = 0;
+
+	if ( (table->count + height) > table->size ) {
+		int   newSize = max(max(table->size * 2, table->count + height), 256);
+		sRow* newRow  = (sRow*)realloc(table->row, sizeof(sRow) * newSize);
+		if (NULL == newRow)
+			ERROR_EXIT(-1, "Unable to allocate %lu bytes for %d rows\n",
+				sizeof(sRow) * newSize, newSize)
+		table->row  = newRow;
+		table->size = newSize;
+	}
+
+	sRow* row = &table->row[table->count];
+	for (int i = 0; i < flag->ndesc; ++i) {
+		if (!isDescLegal(flag, i))
+			continue;
+
+		if (eWrap_normal == e_wrap) {
+			row->desc = i;
+			row->flag = idx;
+			row->wrap = NULL;
+			++row;
+			++result;
+		} else {
+			const sWrapLayout* layout = getDescWrap(&(flag->desc[i]), &wrapBuf, getWrapWidth());
+			for (int j = 0; (j < layout->count) && (result < height); ++j) {
+				row->desc = i;
+				row->flag = idx;
+				row->wrap = &layout->part[j];
+				++row;
+				++result;
 			}
 		}
 	}
+	table->count += result;
+
+	return result;
+}
+
+
+/** @brief hand out @a size bytes from @a arena
+ *  A new block is added to the arena if the current one is too small. The
+ *  memory is aligned for pointers, which is enough for all structs here.
+ *  It is only released by destroyArena().
+ *  @param[in,out] arena pointer to the arena, *arena may be NULL.
+ *  @param[in] size number of bytes needed.
+ *  @return pointer to the memory, the function exits if it fails.
+**/
+void* arenaAlloc (sArena** arena, size_t size)
+{
+	void* result = NULL;
+
+	// Keep everything aligned
+	size = (size + sizeof(void*) - 1) & ~(sizeof(void*) - 1);
+
+	if ( (NULL == *arena) || (size > ((*arena)->size - (*arena)->used)) ) {
+		size_t  blockSize = size > ARENA_BLOCK_SIZE ? size : ARENA_BLOCK_SIZE;
+		sArena* block     = (sArena*)malloc(sizeof(sArena) + blockSize);
+		if (NULL == block)
+			ERROR_EXIT(-1, "Unable to allocate %lu bytes for arena block\n",
+				sizeof(sArena) + blockSize)
+		block->prev = *arena;
+		block->size = blockSize;
+		block->used = 0;
+		*arena      = block;
+	}
+
+	result = (*arena)->data + (*arena)->used;
+	(*arena)->used += size;
+
+	return result;
 }
 
 
-/** @brief destroy a given flag and set its pointer to the next flag or NULL
+/** @brief sort the flags of @a list by name into @a index
+ *  The names are compared ignoring case, equal names keep their
+ *  list order. The index is rebuilt completely on each call.
+ *  @param[in,out] index the index to fill.
+ *  @param[in] list the flags to index.
+**/
+void buildNameIndex (sNameIndex* index, const sFlagList* list)
+{
+	if (index->size < list->count) {
+		int  newSize = max(list->count, 64);
+		int* newFlag = (int*)realloc(index->flag, sizeof(int) * newSize);
+		if (NULL == newFlag)
+			ERROR_EXIT(-1, "Unable to allocate %lu bytes for name index\n",
+				sizeof(int) * newSize)
+		index->flag = newFlag;
+		index->size = newSize;
+	}
+
+	for (int i = 0; i < list->count; ++i)
+		index->flag[i] = i;
+	index->count = list->count;
+
+	sortList = list;
+	qsort(index->flag, index->count, sizeof(int), compareNames);
+	sortList = NULL;
+}
+
+
+/** @brief release all blocks of @a arena at once
+ *  It is completely safe to call this with a pointer to NULL.
+ *  @param[in,out] arena pointer to the arena, set to NULL afterwards.
+**/
+void destroyArena (sArena** arena)
+{
+	while (arena && *arena) {
+		sArena* prev = (*arena)->prev;
+		free (*arena);
+		*arena = prev;
+	}
+}
+
+
+/** @brief destroy all flags of a table and the table itself
  *  This function never fails. It is completely safe to call it with
- *  a NULL pointer or a pointer to NULL.
- *  If the given @a flag is the last in the ring, @a root and @a flag
- *  are both set to NULL after the flags destruction.
- *  If @a flag equals @a root and there are items left in the
- *  ring, @a root is set to its successor.
- *  @param[in,out] root pointer to the root flag.
- *  @param[in,out] flag pointer to an sFlag pointer.
+ *  an empty table. The descriptions of flags created by addFlagRef()
+ *  are left to destroyArena().
+ *  @param[in,out] list the table to clear, it is empty afterwards.
 **/
-void destroyFlag (sFlag** root, sFlag** flag)
-{
-	if (flag && *flag) {
-		sFlag* xFlag = *flag;
-		*flag = xFlag->next != xFlag ? xFlag->next : NULL;
-
-		// a) determine whether the ring is closed:
-		if (*root == xFlag)
-			*root = *flag;
-
-		// b) destroy description lines
-		for (int i = 0; i < xFlag->ndesc; ++i) {
-			if (xFlag->desc[i].pkg)
-				free (xFlag->desc[i].pkg);
-			if (xFlag->desc[i].desc)
-				free (xFlag->desc[i].desc);
-			if (xFlag->desc[i].desc_alt)
-				free (xFlag->desc[i].desc_alt);
-			destroyWrapList(xFlag->desc[i].wrap);
+void destroyFlagList (sFlagList* list)
+{
+	for (int i = 0; list && (i < list->count); ++i) {
+		sFlag* xFlag = &list->flag[i];
+
+		// a) destroy description lines
+		for (int j = 0; j < xFlag->ndesc; ++j) {
+			if (!xFlag->inArena) {
+				if (xFlag->desc[j].pkg)
+					free (xFlag->desc[j].pkg);
+				if (xFlag->desc[j].desc)
+					free (xFlag->desc[j].desc);
+				if (xFlag->desc[j].desc_alt)
+					free (xFlag->desc[j].desc_alt);
+			}
 		}
-		if (xFlag->desc)
+		if (xFlag->desc && !xFlag->inArena)
 			free (xFlag->desc);
 
-		// c) Destroy name and detach from the ring
-		if (xFlag->name)
+		// b) Destroy name
+		if (xFlag->name && !xFlag->inArena)
 			free (xFlag->name);
-		if (xFlag->next && (xFlag->next != xFlag)) {
-			if (xFlag->prev && (xFlag->prev != xFlag))
-				xFlag->prev->next = xFlag->next;
-			xFlag->next->prev = xFlag->prev;
-		} else if (xFlag->prev && (xFlag->prev != xFlag))
-			xFlag->prev->next = NULL;
-		xFlag->next = NULL;
-		xFlag->prev = NULL;
-
-		// d) destroy remaining flag struct and set pointer to NULL
-		free (xFlag);
+	}
+
+	if (list) {
+		if (list->flag)
+			free (list->flag);
+		list->count = 0;
+		list->flag  = NULL;
+		list->size  = 0;
+	}
+}
+
+
+/** @brief free the memory of a line index
+ *  It is completely safe to call this with an empty index.
+ *  @param[in,out] index the index to clear, it is empty afterwards.
+**/
+void destroyLineIndex (sLineIndex* index)
+{
+	if (index) {
+		if (index->height)
+			free (index->height);
+		if (index->tree)
+			free (index->tree);
+		index->count  = 0;
+		index->height = NULL;
+		index->size   = 0;
+		index->tree   = NULL;
+	}
+}
+
+
+/** @brief free the memory of a name index
+ *  It is completely safe to call this with an empty index.
+ *  @param[in,out] index the index to clear, it is empty afterwards.
+**/
+void destroyNameIndex (sNameIndex* index)
+{
+	if (index) {
+		if (index->flag)
+			free (index->flag);
+		index->count = 0;
+		index->flag  = NULL;
+		index->size  = 0;
+	}
+}
+
+
+/** @brief free the memory of a row table
+ *  It is completely safe to call this with an empty table.
+ *  @param[in,out] table the table to clear, it is empty afterwards.
+**/
+void destroyRowTable (sRowTable* table)
+{
+	if (table) {
+		if (table->row)
+			free (table->row);
+		table->count = 0;
+		table->row   = NULL;
+		table->size  = 0;
 	}
 }
 
 
-/** @brief generate globalMasked and globalForced
+/** @brief free the wrap layouts and assembled texts of all descriptions
+ *  The wrap and text pointers of all descriptions are invalid afterwards,
+ *  so this must only be called after the flag lists are destroyed.
+**/
+void destroyWrapLayouts (void)
+{
+	destroyArena(&wrapBuf.arena);
+	if (wrapBuf.scratch)
+		free (wrapBuf.scratch);
+	wrapBuf.scratch = NULL;
+	wrapBuf.size    = 0;
+}
+
+
+/** @brief find the next legal flag after @a after in the range [@a lo, @a hi) of @a index
+ *  "Next" is meant in list order, wrapping around at the end of the
+ *  list, so @a after itself is found last. Flags hidden by the current
+ *  filters are skipped by their legality bits.
+ *  @param[in] index the name index of @a list.
+ *  @param[in] list the flags @a index was built from.
+ *  @param[in] lo first index entry of the range.
+ *  @param[in] hi entry after the last of the range.
+ *  @param[in] after list index of the flag to start after.
+ *  @return the list index of the flag found or -1 if the range has no legal flag.
+**/
+int findNameMatch (const sNameIndex* index, const sFlagList* list, int lo, int hi, int after)
+{
+	int result = -1;
+	int dist   = list->count + 1;
+
+	for (int i = lo; i < hi; ++i) {
+		int idx = index->flag[i];
+		int d   = (idx - after + list->count - 1) % list->count;
+		if ( (d < dist) && isFlagLegal(&list->flag[idx]) ) {
+			dist   = d;
+			result = idx;
+		}
+	}
+
+	return result;
+}
+
+
+/** @brief generate globalMasked, globalForced and the legality masks
  * This function checks whether either the first global description,
  * or all local descriptions with no available global description of
  * a flag is/are masked and/or forced and sets the global states
  * accordingly.
+ * Afterwards every description gets the mask of filter combinations
+ * it is shown with, and the flag the combination of all of them.
+ * This must be called once all descriptions are added.
  * @param[in,out] flag pointer to the flag to check
  */
 void genFlagStats (sFlag* flag)
@@ -286,15 +497,95 @@ void genFlagStats (sFlag* flag)
 			flag->globalForced = allLocalForced;
 			flag->globalMasked = allLocalMasked;
 		}
+
+		// With the global states known the legality can be fixed
+		flag->legal = 0;
+		for (int i = 0; i < flag->ndesc; ++i) {
+			flag->desc[i].legal = 0;
+			for (eScope scope = eScope_all; scope <= eScope_local; ++scope) {
+				for (eState state = eState_all; state <= eState_notinstalled; ++state) {
+					for (eMask mask = eMask_unmasked; mask <= eMask_both; ++mask) {
+						if (calculateDescLegal(flag, i, scope, state, mask))
+							flag->desc[i].legal |= FILTER_BIT(scope, state, mask);
+					}
+				}
+			}
+			flag->legal |= flag->desc[i].legal;
+		}
+	}
+}
+
+
+/** @brief get the line @a desc as drawn for the current order and description mode
+ *  The package list is put in brackets left or right of the description,
+ *  see e_order. The text is assembled on first use and again only after
+ *  the order or description mode changed. It lives in the arena of the
+ *  wrap layouts, so this must only be called by the UI thread.
+ *  @param[in,out] desc the description line, its text is updated if needed.
+ *  @return the text, valid until destroyWrapLayouts() is called.
+**/
+const sDescText* getDescText (sDesc* desc)
+{
+	sDescText* text = desc->text;
+
+	if (NULL == text) {
+		size_t dLen = strlen(desc->desc);
+		size_t aLen = desc->desc_alt ? strlen(desc->desc_alt) : 0;
+		size_t pLen = desc->pkg ? strlen(desc->pkg) + 3 : 0; // space and brackets.
+
+		text = (sDescText*)arenaAlloc(&wrapBuf.arena,
+				sizeof(sDescText) + max(dLen, aLen) + pLen + 1);
+		desc->text = text;
+	} else if ((e_order == text->order) && (e_desc == text->stripped))
+		return text;
+
+	// Lines without packages always show the original description
+	if (desc->pkg) {
+		const
+		char* pDesc = (eDesc_ori == e_desc) || !desc->desc_alt ? desc->desc : desc->desc_alt;
+		if (eOrder_left == e_order)
+			text->len = sprintf(text->text, "(%s) %s", desc->pkg, pDesc);
+		else
+			text->len = sprintf(text->text, "%s (%s)", pDesc, desc->pkg);
+	} else
+		text->len = sprintf(text->text, "%s", desc->desc);
+	text->order    = e_order;
+	text->stripped = e_desc;
+
+	return text;
+}
+
+
+/** @brief find the flag shown on the visible @a line of an index
+ *  Filtered flags have no height, so the result is never one of them.
+ *  @param[in] index the line index to search.
+ *  @param[in] line the visible line, counted from 0.
+ *  @return the index of the flag or index->count if @a line is behind the last one.
+**/
+int getFlagAtLine (const sLineIndex* index, int line)
+{
+	int pos  = 0;
+	int step = 1;
+
+	// Find the last position whose partial sum does not exceed line
+	while ( (step * 2) <= index->size )
+		step *= 2;
+	for ( ; step && (line >= 0); step /= 2) {
+		if ( ((pos + step) <= index->size) && (index->tree[pos + step] <= line) ) {
+			pos  += step;
+			line -= index->tree[pos];
+		}
 	}
+
+	return min(pos, index->count);
 }
 
 
 /** @brief determine the number of lines used by @a flag
  *  This method checks the flag and its description line(s)
  *  settings against the globally active filters.
- *  If line wrapping is active, the wrap settings are
- *  recalculated if neccessary.
+ *  If line wrapping is active, the wrap layout of each
+ *  legal description is calculated if it is not cached.
  *  If @a flag is NULL, the result will be 0.
  *  @param[in] flag pointer to the flag to check.
  *  @return number of lines needed to display the line *without* possible line wrapping.
@@ -304,28 +595,12 @@ int getFlagHeight (const sFlag* flag)
 	int result = 0;
 
 	if (flag) {
-		size_t maxLen = wWidth(List) - (minwidth + 8);
 		for (int i = 0; i < flag->ndesc; ++i) {
 			if (isDescLegal(flag, i)) {
 				if (eWrap_normal == e_wrap)
 					++result;
-				else {
-					/* Check settings. The calculations must not
-					 * be done unless neccessary to not cripple
-					 * performance.
-					 */
-					sDesc* desc = &(flag->desc[i]);
-					if ( !desc->wrap
-					  || (desc->wrapWidth != maxLen)
-					  || (desc->wrapOrder != e_order)
-					  || (desc->wrapStripped != e_desc) ) {
-						desc->wrapWidth    = maxLen;
-						desc->wrapOrder    = e_order;
-						desc->wrapStripped = e_desc;
-						calculateDescWrap(desc);
-					}
-					result += desc->wrapCount;
-				}
+				else
+					result += getDescWrap(&(flag->desc[i]), &wrapBuf, getWrapWidth())->count;
 			} // End of having a legal flag
 		} // End of looping descriptions
 	} // End of having a flag
@@ -334,6 +609,30 @@ int getFlagHeight (const sFlag* flag)
 }
 
 
+/** @brief get the number of visible lines of all flags of an index
+**/
+int getLineCount (const sLineIndex* index)
+{
+	return getLineOfFlag(index, index->count);
+}
+
+
+/** @brief get the visible line the flag @a idx starts on
+ *  @param[in] index the line index to ask.
+ *  @param[in] idx index of the flag, index->count gives the number of lines.
+ *  @return the sum of the heights of all flags before @a idx.
+**/
+int getLineOfFlag (const sLineIndex* index, int idx)
+{
+	int result = 0;
+
+	for (int pos = min(idx, index->count); pos > 0; pos -= pos & -pos)
+		result += index->tree[pos];
+
+	return result;
+}
+
+
 /** @brief return true if a specific description line is force enabled
  *  If @a flag is NULL, the result will be false.
  *  @param[in] flag pointer to the flag to check.
@@ -356,6 +655,8 @@ bool isDescForced(const sFlag* flag, int idx)
 
 
 /** @brief return true if the flag description @a idx is ok to display.
+ *  The legality for all filter combinations is calculated by
+ *  genFlagStats(), so this is a single bit test.
  *  If @a flag is NULL, the result will be false.
  *  @param[in] flag pointer to the flag to check.
  *  @param[in] idx index of the description line to check.
@@ -363,30 +664,7 @@ bool isDescForced(const sFlag* flag, int idx)
  */
 bool isDescLegal (const sFlag* flag, int idx)
 {
-	bool result = false;
-
-	if (flag && (idx < flag->ndesc)) {
-		if ( // 1.: Check isGlobal versus e_scope
-			 ( ( flag->desc[idx].isGlobal && (e_scope != eScope_local))
-			|| (!flag->desc[idx].isGlobal && (e_scope != eScope_global)) )
-			 // 2.: Check isInstalled versus e_state
-		  && ( ( flag->desc[idx].isInstalled && (e_state != eState_notinstalled))
-			|| (!flag->desc[idx].isInstalled && (e_state != eState_installed)) )
-			 // 3.: Check stateForced/stateMasked versus e_mask
-		  && ( ( (e_mask != eMask_unmasked)
-			  && ( (flag->globalMasked && ('-' != flag->desc[idx].stateMasked))
-				|| ('+' == flag->desc[idx].stateMasked)
-			    || (flag->globalForced && ('-' != flag->desc[idx].stateForced))
-				|| ('+' == flag->desc[idx].stateForced) ) )
-		    || ( (e_mask != eMask_masked)
-			  && ( (!flag->globalMasked && ('+' != flag->desc[idx].stateMasked))
-				|| ('-' == flag->desc[idx].stateMasked) )
-			  && ( (!flag->globalForced && ('+' != flag->desc[idx].stateForced))
-				|| ('-' == flag->desc[idx].stateForced) ) ) ) )
-			result = true;
-	}
-
-	return result;
+	return flag && (idx < flag->ndesc) && (flag->desc[idx].legal & getFilterBit());
 }
 
 
@@ -418,25 +696,104 @@ bool isDescMasked(const sFlag* flag, int idx)
 
 
 /** @brief return true if this flag has at least one line to display.
- *  This method checks the flag and its description line(s)
- *  settings against the globally active filters.
- *  The function returns as soon as the first displayable line is
- *  found and can be therefore faster than getFlagHeight().
+ *  This method checks the combined legality of the flags description
+ *  line(s) against the globally active filters, see genFlagStats().
  *  If @a flag is NULL, the result will be false.
  *  @param[in] flag pointer to the flag to check.
  *  @return true if at least one line has to be shown.
  */
 bool isFlagLegal (const sFlag* flag)
 {
-	bool result = false;
+	return flag && (flag->legal & getFilterBit());
+}
 
-	if (flag) {
-		for (int i = 0; !result && (i < flag->ndesc); ++i) {
-			result = isDescLegal(flag, i);
-		}
+
+/** @brief narrow a range of @a index to the names having @a c at @a pos
+ *  All names in [@a lo, @a hi) must share their first @a pos characters,
+ *  so the range is sorted by the character at @a pos and both ends are
+ *  found by binary search. Case is ignored.
+ *  @param[in] index the name index of @a list.
+ *  @param[in] list the flags @a index was built from.
+ *  @param[in] pos position of the character to compare.
+ *  @param[in] c the character the names must have at @a pos.
+ *  @param[in,out] lo first index entry of the range.
+ *  @param[in,out] hi entry after the last of the range.
+ *  @return the number of entries left in the range.
+**/
+int narrowNameRange (const sNameIndex* index, const sFlagList* list, int pos, char c, int* lo, int* hi)
+{
+	int key   = tolower((unsigned char)c);
+	int first = *lo;
+	int last  = *hi;
+
+	// First entry not below key
+	for (int n = last - first; n > 0; ) {
+		int half = n / 2;
+		if (getNameChar(list, index->flag[first + half], pos) < key) {
+			first += half + 1;
+			n     -= half + 1;
+		} else
+			n = half;
 	}
 
-	return result;
+	// First entry above key
+	last = first;
+	for (int n = *hi - first; n > 0; ) {
+		int half = n / 2;
+		if (getNameChar(list, index->flag[last + half], pos) <= key) {
+			last += half + 1;
+			n    -= half + 1;
+		} else
+			n = half;
+	}
+
+	*lo = first;
+	*hi = last;
+
+	return last - first;
+}
+
+
+/** @brief make sure @a list can hold @a count flags without growing
+ *  The table is moved when it grows, so every pointer to a flag in it
+ *  becomes invalid. Tables that are used while flags are still added
+ *  must therefore reserve their full size first.
+ *  @param[in,out] list the table to enlarge.
+ *  @param[in] count the number of flags the table must be able to hold.
+**/
+void reserveFlags (sFlagList* list, int count)
+{
+	if (list && (count > list->size)) {
+		sFlag* newFlags = (sFlag*)realloc(list->flag, sizeof(sFlag) * count);
+		if (NULL == newFlags)
+			ERROR_EXIT(-1, "Unable to allocate %lu bytes for %d sFlag_ structs\n",
+				sizeof(sFlag) * count, count)
+		list->flag = newFlags;
+		list->size = count;
+	}
+}
+
+
+/** @brief empty a line index and make it hold up to @a size flags
+ *  @param[in,out] index the index to reset.
+ *  @param[in] size the number of flags the index must be able to hold.
+**/
+void resetLineIndex (sLineIndex* index, int size)
+{
+	if (size > index->size) {
+		int* newHeight = (int*)realloc(index->height, sizeof(int) * size);
+		int* newTree   = (int*)realloc(index->tree,   sizeof(int) * (size + 1));
+		if ( (NULL == newHeight) || (NULL == newTree) )
+			ERROR_EXIT(-1, "Unable to allocate %lu bytes for the line index\n",
+				sizeof(int) * (2 * size + 1))
+		index->height = newHeight;
+		index->tree   = newTree;
+		index->size   = size;
+	}
+
+	if (index->tree)
+		memset(index->tree, 0, sizeof(int) * (index->size + 1));
+	index->count = 0;
 }
 
 
@@ -515,44 +872,134 @@ void setKeyDispLen(sKey* keys, size_t dispWidth)
 }
 
 
+/** @brief set the visible height of flag @a idx in O(log n)
+ *  If @a idx equals the number of indexed flags, the flag is appended.
+ *  @param[in,out] index the line index to update.
+ *  @param[in] idx index of the flag, must not be larger than index->count.
+ *  @param[in] height the new height of the flag.
+**/
+void setLineHeight (sLineIndex* index, int idx, int height)
+{
+	int delta = 0;
+
+	if ( (idx < 0) || (idx > index->count) || (idx >= index->size) )
+		ERROR_EXIT(-1, "Flag %d is out of the line index range\n", idx)
+
+	if (idx == index->count) {
+		index->height[idx] = 0;
+		++index->count;
+	}
+	delta              = height - index->height[idx];
+	index->height[idx] = height;
+
+	for (int pos = idx + 1; delta && (pos <= index->size); pos += pos & -pos)
+		index->tree[pos] += delta;
+}
+
+
+/** @brief calculate the wrap layouts of the flags of @a list from @a first on
+ *  The legal descriptions are wrapped for the current width, order and
+ *  description mode by a pool of threads, one per online CPU. The calling
+ *  thread takes part and the function returns when all are done, so that
+ *  getFlagHeight() and addFlagRows() find every layout cached afterwards.
+ *  Nothing is done if descriptions are not wrapped.
+ *  @param[in,out] list the flags to wrap.
+ *  @param[in] first index of the first flag to wrap.
+**/
+void wrapFlags (sFlagList* list, int first)
+{
+	if ( (eWrap_wrap != e_wrap) || !list || (first >= list->count) )
+		return;
+
+	pthread_t workers[WRAP_MAX_WORKERS];
+	sWrapBuf  bufs[WRAP_MAX_WORKERS];
+	long      cpus        = sysconf(_SC_NPROCESSORS_ONLN);
+	int       chunks      = (list->count - first + WRAP_CHUNK_SIZE - 1) / WRAP_CHUNK_SIZE;
+	int       workerCount = min(min(cpus > 0 ? (int)cpus : 1, WRAP_MAX_WORKERS), chunks) - 1;
+	int       started     = 0;
+
+	wrapList  = list;
+	wrapNext  = first;
+	wrapWidth = getWrapWidth();
+
+	// Start the helpers, the calling thread is a worker itself
+	for (int i = 0; i < workerCount; ++i) {
+		bufs[i].arena   = NULL;
+		bufs[i].scratch = NULL;
+		bufs[i].size    = 0;
+	}
+	while ( (started < workerCount)
+		 && (0 == pthread_create(&workers[started], NULL, wrapWorker, &bufs[started])) )
+		++started;
+	wrapWorker(&wrapBuf);
+
+	// Hand the arenas of the helpers over to the UI thread buffer
+	for (int i = 0; i < started; ++i) {
+		pthread_join(workers[i], NULL);
+		if (bufs[i].arena) {
+			sArena* oldest = bufs[i].arena;
+			while (oldest->prev)
+				oldest = oldest->prev;
+			oldest->prev  = wrapBuf.arena;
+			wrapBuf.arena = bufs[i].arena;
+		}
+		if (bufs[i].scratch)
+			free (bufs[i].scratch);
+	}
+
+	wrapList = NULL;
+}
+
+
 /* === Internal functions only used here === */
 
-/// @brief calculate the current wrap chain for description @a desc
-static void calculateDescWrap(sDesc* desc)
+
+/// @brief return true if description @a idx of @a flag is shown with the given filters
+static bool calculateDescLegal(const sFlag* flag, int idx, eScope scope, eState state, eMask mask)
 {
-	if (desc) {
-		sWrap* curr  = desc->wrap;
-		sWrap* next  = NULL;
-		char*  pDesc = eDesc_ori == desc->wrapStripped ? desc->desc : desc->desc_alt;
+	const sDesc* desc = &(flag->desc[idx]);
+
+	return // 1.: Check isGlobal versus scope
+		 ( ( desc->isGlobal && (scope != eScope_local))
+		|| (!desc->isGlobal && (scope != eScope_global)) )
+		 // 2.: Check isInstalled versus state
+	  && ( ( desc->isInstalled && (state != eState_notinstalled))
+		|| (!desc->isInstalled && (state != eState_installed)) )
+		 // 3.: Check stateForced/stateMasked versus mask
+	  && ( ( (mask != eMask_unmasked)
+		  && ( (flag->globalMasked && ('-' != desc->stateMasked))
+			|| ('+' == desc->stateMasked)
+		    || (flag->globalForced && ('-' != desc->stateForced))
+			|| ('+' == desc->stateForced) ) )
+	    || ( (mask != eMask_masked)
+		  && ( (!flag->globalMasked && ('+' != desc->stateMasked))
+			|| ('-' == desc->stateMasked) )
+		  && ( (!flag->globalForced && ('+' != desc->stateForced))
+			|| ('-' == desc->stateForced) ) ) );
+}
+
+/// @brief calculate the wrapped parts of description @a desc for the settings of @a layout using @a buf
+static void calculateDescWrap(const sDesc* desc, sWrapLayout* layout, sWrapBuf* buf)
+{
+	if (desc && layout && buf) {
+		const
+		char*  pDesc = eDesc_ori == layout->stripped ? desc->desc : desc->desc_alt;
+		const
 		char*  pPkg  = desc->pkg;
-		char*  pch   = eOrder_left == desc->wrapOrder ? pPkg : pDesc;
+		const
+		char*  pch   = eOrder_left == layout->order ? pPkg : pDesc;
+		sWrap* curr  = NULL;
+		int    count = 0;
 		size_t start = 0;
 		size_t end   = 0;
-		size_t width = desc->wrapWidth - 2; // Follow-up lines are indented
+		size_t width = layout->width - 2; // Follow-up lines are indented
 		size_t dLen  = pDesc ? strlen(pDesc) : 0;
 		size_t pLen  = pPkg ? strlen(pPkg) : 0;
 		size_t left  = dLen + pLen;
-		size_t wLen  = (eOrder_left == desc->wrapOrder ? pLen : dLen) - 1;
+		size_t wLen  = (eOrder_left == layout->order ? pLen : dLen) - 1;
 		size_t oLen  = 0; // Set to the first part to be added to pos on the second
 		// part, so drawflag knows from where to start taking in the unified desc.
 
-		/* A valid curr is needed first */
-		if (NULL == curr) {
-			curr = (sWrap*)malloc(sizeof(sWrap));
-			if (curr) {
-				curr->len  = 0;
-				curr->next = NULL;
-				curr->pos  = 0;
-				desc->wrap = curr;
-			} else
-				ERROR_EXIT(-1,
-					"Unable to allocate %lu bytes for sWrap_ struct\n",
-					sizeof(sWrap))
-		}
-
-		// The description starts without a valid wrap now
-		desc->wrapCount = 0;
-
 		/* When starting there are two possible situations.
 		 * a) A global flag with order left, so desc->pkg and therefore
 		 *    pch also are NULL
@@ -569,11 +1016,21 @@ static void calculateDescWrap(sDesc* desc)
 		// Now distribute all characters
 		while (left) {
 
-			// Step 1: Set current wrap part end
-			end = start + width;
+			// Step 1: Get a part in the scratch buffer and set its end
+			if (count == buf->size) {
+				int    newSize = max(buf->size * 2, 16);
+				sWrap* newWrap = (sWrap*)realloc(buf->scratch, sizeof(sWrap) * newSize);
+				if (NULL == newWrap)
+					ERROR_EXIT(-1, "Unable to allocate %lu bytes for %d sWrap_ structs\n",
+						sizeof(sWrap) * newSize, newSize)
+				buf->scratch = newWrap;
+				buf->size    = newSize;
+			}
+			curr = &buf->scratch[count];
+			end  = start + width;
 
 			// First line has two more spaces:
-			if (curr == desc->wrap)
+			if (0 == count)
 				end += 2;
 
 			// Package lists have one space less in their first line,
@@ -614,7 +1071,6 @@ static void calculateDescWrap(sDesc* desc)
 			curr->len = end - start + (isEnd ? 1 : 0);
 			start += curr->len;
 			left  -= curr->len;
-			++desc->wrapCount;
 
 			// skip white space
 			while (left && (start <= wLen) && (' ' == pch[start])) {
@@ -633,10 +1089,13 @@ static void calculateDescWrap(sDesc* desc)
 				if (!isStart)	++curr->pos;
 			}
 
+			// Step 4: Keep the part unless it is empty
+			if (curr->len)
+				++count;
 
-			// Step 4: Switch if the current string is exhausted:
+			// Step 5: Switch if the current string is exhausted:
 			if (left && (isEnd || (start > wLen) ) ) {
-				if (eOrder_left == desc->wrapOrder) {
+				if (eOrder_left == layout->order) {
 					// Switch from pkg to desc
 					pch  = pDesc;
 					wLen = dLen - 1;
@@ -649,49 +1108,178 @@ static void calculateDescWrap(sDesc* desc)
 				}
 				start = 0;
 			} // End of having to swap pkg/desc
+		} // End of having characters left to distribute
 
-			// Step 5: Extend if needed
-			if (curr->len) {
-				next = curr->next;
-				if (left && !next) {
-					next = (sWrap*)malloc(sizeof(sWrap));
-					if (next) {
-						next->len  = 0;
-						next->next = NULL;
-						next->pos  = 0;
-						curr->next = next;
-					} else
-						ERROR_EXIT(-1,
-							"Unable to allocate %lu bytes for sWrap_ struct\n",
-							sizeof(sWrap))
-				}
-			}
+		// Step 6: Move the parts into the arena. The array of the layout
+		// is reused if it is large enough, so the arena only grows until
+		// each layout has seen its largest number of parts.
+		if (count > layout->size) {
+			layout->part = (sWrap*)arenaAlloc(&buf->arena, sizeof(sWrap) * count);
+			layout->size = count;
+		}
+		if (count)
+			memcpy(layout->part, buf->scratch, sizeof(sWrap) * count);
+		layout->count = count;
+	} // End of having not NULL pointers
+}
+
+
+/// @brief qsort() comparison of two flag indices of sortList by name ignoring case, then by index
+static int compareNames(const void* lhs, const void* rhs)
+{
+	int l      = *(const int*)lhs;
+	int r      = *(const int*)rhs;
+	int result = strcasecmp(sortList->flag[l].name, sortList->flag[r].name);
+
+	return result ? result : l - r;
+}
+
+
+/// @brief append a new flag to @a list, see addFlag() and addFlagRef()
+static sFlag* createFlag(sFlagList* list, sArena** arena, char* name, int line, int ndesc, const char state[2])
+{
+	sFlag* newFlag = NULL;
+
+	// Exit early if list is NULL:
+	if (!list)
+		ERROR_EXIT(-1, "list must not be %s\n", "NULL")
 
-			// Step 6: Clean up if done
-			if (!left && next) {
-				curr->next = NULL;
-				destroyWrapList(next);
-				next = NULL;
+	if (name) {
+
+		// state is a byte mask. Check it first:
+		for (int i = 0; i < 2; ++i) {
+			if (('+' != state[i]) && ('-' != state[i]) && (' ' != state[i]))
+				ERROR_EXIT(-1, "Illegal character '%c' in state string at position %d\n",
+					state[i], i)
+		}
+
+		if (list->count == list->size)
+			reserveFlags(list, list->size ? list->size * 2 : 64);
+		newFlag = &list->flag[list->count++];
+
+		if (arena)
+			newFlag->desc = (sDesc*)arenaAlloc(arena, sizeof(sDesc) * ndesc);
+		else
+			newFlag->desc = (sDesc*)malloc(sizeof(sDesc) * ndesc);
+
+		if (newFlag->desc) {
+			for (int i = 0; i < ndesc; ++i) {
+				newFlag->desc[i].desc         = NULL;
+				newFlag->desc[i].desc_alt     = NULL;
+				newFlag->desc[i].isGlobal     = false;
+				newFlag->desc[i].isInstalled  = false;
+				newFlag->desc[i].legal        = 0;
+				newFlag->desc[i].pkg          = NULL;
+				newFlag->desc[i].stateForced  = ' ';
+				newFlag->desc[i].stateMasked  = ' ';
+				newFlag->desc[i].statePackage = ' ';
+				newFlag->desc[i].text         = NULL;
+				newFlag->desc[i].wrap         = NULL;
 			}
+		} else
+			ERROR_EXIT(-1, "Unable to allocate %lu bytes for %d sDesc_ structs\n",
+				sizeof(sDesc) * ndesc, ndesc)
+
+		newFlag->currline     = 0;
+		newFlag->globalForced = false;
+		newFlag->globalMasked = false;
+		newFlag->inArena      = arena ? true : false;
+		newFlag->info         = NULL;
+		newFlag->infoConf     = ' ';
+		newFlag->infoWidth    = 0;
+		newFlag->legal        = 0;
+		newFlag->listline     = line;
+		newFlag->name         = name;
+		newFlag->ndesc        = ndesc;
+		newFlag->stateConf    = state[0];
+		newFlag->stateDefault = state[1];
+	} else
+		ERROR_EXIT(-1, "The new flags must have a name, not %s\n", "NULL")
 
-			// Step 7: Advance
-			if (curr->len)
-				curr = next;
-		} // End of having characters left to distribute
-	} // End of having a not NULL pointer
+	return newFlag;
+}
+
+
+/** @brief get the wrap layout of @a desc for @a width and the current order and description mode
+ *  The layout is looked up in the WRAP_LAYOUTS layouts of the description
+ *  and moved to the front. If it is not found, the least recently used
+ *  layout is recalculated. So the layouts are only ever calculated for
+ *  descriptions that are shown with wrapping.
+ *  Anything new is allocated from @a buf, so different threads can work
+ *  on different descriptions.
+**/
+static sWrapLayout* getDescWrap(sDesc* desc, sWrapBuf* buf, size_t width)
+{
+	sWrapLayout* layout = desc->wrap;
+	int          i      = 0;
+
+	if (NULL == layout) {
+		layout = (sWrapLayout*)arenaAlloc(&buf->arena, sizeof(sWrapLayout) * WRAP_LAYOUTS);
+		for (i = 0; i < WRAP_LAYOUTS; ++i) {
+			layout[i].count    = 0;
+			layout[i].order    = e_order;
+			layout[i].part     = NULL;
+			layout[i].size     = 0;
+			layout[i].stripped = e_desc;
+			layout[i].width    = 0;
+		}
+		desc->wrap = layout;
+		i = 0;
+	}
+
+	// The last layout is taken if no other matches or is unused
+	for ( ; i < (WRAP_LAYOUTS - 1); ++i) {
+		if ( !layout[i].width
+		  || ( (layout[i].width    == width)
+		    && (layout[i].order    == e_order)
+		    && (layout[i].stripped == e_desc) ) )
+			break;
+	}
+
+	if (i) {
+		sWrapLayout found = layout[i];
+		memmove(&layout[1], &layout[0], sizeof(sWrapLayout) * i);
+		layout[0] = found;
+	}
+
+	if ( (layout->width    != width)
+	  || (layout->order    != e_order)
+	  || (layout->stripped != e_desc) ) {
+		layout->width    = width;
+		layout->order    = e_order;
+		layout->stripped = e_desc;
+		calculateDescWrap(desc, layout, buf);
+	}
+
+	return layout;
 }
 
 
-/// @brief destroy one sWrap singly linked list
-static void destroyWrapList(sWrap* wrap)
+/** @brief calculate wrap layouts for the legal descriptions of the flags claimed from wrapNext
+ *  This is the thread function of wrapFlags(), the flags are taken
+ *  in chunks of WRAP_CHUNK_SIZE until the list is done.
+ *  @param[in,out] buf pointer to the sWrapBuf_ of this thread.
+**/
+static void* wrapWorker(void* buf)
 {
-	if (wrap) {
-		sWrap* wrapRoot = wrap;
-		sWrap* wrapNext = wrapRoot ? wrapRoot->next : NULL;
-		while (wrapRoot) {
-			free (wrapRoot);
-			wrapRoot = wrapNext;
-			wrapNext = wrapRoot ? wrapRoot->next : NULL;
+	for (;;) {
+		pthread_mutex_lock(&wrapLock);
+		int first = wrapNext;
+		wrapNext += WRAP_CHUNK_SIZE;
+		pthread_mutex_unlock(&wrapLock);
+
+		if (first >= wrapList->count)
+			break;
+
+		int last = min(first + WRAP_CHUNK_SIZE, wrapList->count);
+		for (int idx = first; idx < last; ++idx) {
+			sFlag* flag = &wrapList->flag[idx];
+			for (int i = 0; i < flag->ndesc; ++i) {
+				if (isDescLegal(flag, i))
+					getDescWrap(&(flag->desc[i]), (sWrapBuf*)buf, wrapWidth);
+			}
 		}
 	}
+
+	return NULL;
 }
@@ -104,22 +104,73 @@ typedef enum eWrap_ {
 } eWrap;
 
 
+/** @brief bit of a filter combination in the legality masks of sDesc_ and sFlag_
+ *  Each of the three filters has three states, so 27 bits are used.
+**/
+#define FILTER_BIT(scope, state, mask) \
+	(1 << ((scope) * 9 + (state) * 3 + (mask)))
+
+
+/** @brief number of wrap layouts kept per description, see sWrapLayout_
+**/
+#define WRAP_LAYOUTS 4
+
+
 /* ===============
  * === structs ===
  * ===============
  */
 
 
+/** @struct sArena_
+ *  @brief One block of a bump allocator, see arenaAlloc()
+**/
+typedef struct sArena_ {
+	struct
+	sArena_* prev;   //!< The block filled before this one
+	size_t   size;   //!< Usable size of data
+	size_t   used;   //!< Bytes of data already handed out
+	char     data[]; //!< The memory handed out
+} sArena;
+
+
 /** @struct sWrap_
  *  @brief Describe one start and length of a wrapped description line
 **/
 typedef struct sWrap_ {
-	size_t  len; //!< Length of the wrapped line part
-	size_t  pos; //!< Starting position of a wrapped line part
-	struct
-	sWrap_* next; //!< Next part of the wrapped line
+	int len; //!< Length of the wrapped line part
+	int pos; //!< Starting position of a wrapped line part
 } sWrap;
 
+
+/** @struct sWrapLayout_
+ *  @brief The wrapped parts of a description for one width, order and description mode
+ *  Each description keeps WRAP_LAYOUTS of them, most recently used first,
+ *  so switching back to a previous terminal width or mode needs no rewrap.
+**/
+typedef struct sWrapLayout_ {
+	int    count;    //!< number of parts
+	eOrder order;    //!< State of e_order the parts are calculated for
+	sWrap* part;     //!< array of size parts, the first count are used
+	int    size;     //!< number of parts the array can hold
+	eDesc  stripped; //!< State of e_desc the parts are calculated for
+	size_t width;    //!< The width available the parts are calculated for, 0 if unused
+} sWrapLayout;
+
+
+/** @struct sDescText_
+ *  @brief A description with its package list as drawn for one order and description mode
+ *  The text is allocated large enough for every order and mode, so it
+ *  is assembled again in place if one of them changes.
+**/
+typedef struct sDescText_ {
+	size_t len;      //!< length of text
+	eOrder order;    //!< State of e_order the text is assembled for
+	eDesc  stripped; //!< State of e_desc the text is assembled for
+	char   text[];   //!< The assembled text
+} sDescText;
+
+
 /** @struct sDesc_
  *  @brief Describe one description line
 **/
@@ -128,51 +179,95 @@ typedef struct sDesc_ {
 	char*  desc_alt;     //!< The alternative description line
 	bool   isGlobal;     //!< true if this is the global description and setting
 	bool   isInstalled;  //!< global: at least one pkg is installed, local: all in *pkg are installed.
+	int    legal;        //!< FILTER_BIT() mask of the filter combinations showing this line
 	char*  pkg;          //!< affected packages
 	char   stateForced;  //!< unforced '-', forced '+' or not set ' ' by *use.force
 	char   stateMasked;  //!< unmasked '-', masked '+' or not sed ' ' by *use.mask
 	char   stateDefault; //!< disabled '-', enabled '+' or not set ' ' ebuilds IUSE (installed packages only)
 	char   statePackage; //!< disabled '-', enabled '+' or not set ' ' by profiles package.use
 	char   statePkgUse;  //!< disabled '-', enabled '+' or not set ' ' by users package.use
-	sWrap* wrap;         //!< If lines are wrapped, this list describes the parts
-	int    wrapCount;    //!< How many parts there are.
-	eOrder wrapOrder;    //!< State of e_order when the wrap parts were calculated last
-	eDesc  wrapStripped; //!< State of e_desc when the wrap parts were calculated last
-	size_t wrapWidth;    //!< The width available the wrap parts are calculated from
+	sDescText*   text;   //!< The line as drawn, NULL until it is drawn once, see getDescText()
+	sWrapLayout* wrap;   //!< WRAP_LAYOUTS wrap layouts, NULL until the line is wrapped once
 } sDesc;
 
 
 /** @struct sFlag_
- *  @brief Describe one flag and its make.conf setting in a doubly linked ring
+ *  @brief Describe one flag and its make.conf setting in an sFlagList
 **/
 typedef struct sFlag_ {
 	int     currline;     //!< The current line on the screen this flag starts
 	sDesc*  desc;         //!< variable array of sDesc structs
 	bool    globalForced; //!< true if the first global description is force enabled.
 	bool    globalMasked; //!< true if the first global description is mask enabled.
+	bool    inArena;      //!< true if desc is allocated by addFlagRef() and the strings are no copies.
+	char*   info;         //!< The name column as drawn, NULL until it is drawn once
+	char    infoConf;     //!< stateConf the name column is drawn for
+	int     infoWidth;    //!< width of the name column, the size of info is infoWidth + 1
+	int     legal;        //!< FILTER_BIT() mask of the filter combinations showing any line
 	int     listline;     //!< The fixed line within the full list this flag starts
 	char*   name;         //!< Name of the flag or NULL for help lines
 	int     ndesc;        //!< number of description lines
-	struct
-	sFlag_* next;         //!< Next flag in the doubly linked ring
-	struct
-	sFlag_* prev;         //!< Previous flag in the doubly linked ring
 	char    stateConf;    //!< disabled '-', enabled '+' or not set ' ' by make.conf
 	char    stateDefault; //!< disabled '-', enabled '+' or not set ' ' by make.defaults
 } sFlag;
 
 
-/** @struct sListStats_
- *  @brief hold stats of the flag list like line counts
+/** @struct sFlagList_
+ *  @brief Table of flags in list order, flags are addressed by their index
+ *  The flags are stored in one contiguous array. Only the strings live
+ *  elsewhere, so walking the table does not touch them.
+**/
+typedef struct sFlagList_ {
+	int    count; //!< number of flags in the table
+	sFlag* flag;  //!< array of size flags, the first count are used
+	int    size;  //!< number of flags the table can hold without growing
+} sFlagList;
+
+
+/** @struct sLineIndex_
+ *  @brief Fenwick tree over the visible heights of the flags of a table
+ *  Both the visible line a flag starts on and the flag shown on a
+ *  visible line are found in O(log n).
+**/
+typedef struct sLineIndex_ {
+	int  count;  //!< number of flags indexed
+	int* height; //!< visible height of each indexed flag
+	int  size;   //!< number of flags the index can hold
+	int* tree;   //!< the partial sums, 1-based with size + 1 elements
+} sLineIndex;
+
+
+/** @struct sNameIndex_
+ *  @brief Flags of a table sorted by their names, ignoring case
+ *  All flags starting with the same prefix form one range of the
+ *  index, that is narrowed by one character at a time.
+**/
+typedef struct sNameIndex_ {
+	int  count; //!< number of flags indexed
+	int* flag;  //!< flag indices sorted by name
+	int  size;  //!< number of flags the index can hold
+} sNameIndex;
+
+
+/** @struct sRow_
+ *  @brief Describe one visible line of the list, see sRowTable_
+**/
+typedef struct sRow_ {
+	int          desc; //!< index of the description shown on this line
+	int          flag; //!< index of the flag in its table
+	const sWrap* wrap; //!< the wrapped part shown, NULL if descriptions are not wrapped
+} sRow;
+
+
+/** @struct sRowTable_
+ *  @brief Table of all lines visible with the current filters and wrapping
+ *  Drawing the list only needs the slice of rows that is on the screen.
 **/
-typedef struct sListStats_ {
-	int lineCountGlobal;
-	int lineCountGlobalInstalled;
-	int lineCountLocal;
-	int lineCountLocalInstalled;
-	int lineCountMasked;
-	int lineCountMaskedInstalled;
-} sListStats;
+typedef struct sRowTable_ {
+	int   count; //!< number of rows in the table
+	sRow* row;   //!< array of size rows, the first count are used
+	int   size;  //!< number of rows the table can hold without growing
+} sRowTable;
 
 
 /** @struct sKey_
@@ -215,16 +310,35 @@ typedef struct sWindow_ {
  * === public functions handling types ===
  * =======================================
  */
-sFlag* addFlag      (sFlag** root, const char* name, int line, int ndesc, const char state[2]);
-size_t addFlagDesc  (sFlag* flag, const char* pkg, const char* desc, const char* desc_alt, const char state[6]);
-void   addLineStats (const sFlag* flag, sListStats* stats);
-void   destroyFlag  (sFlag** root, sFlag** flag);
-void   genFlagStats (sFlag* flag);
-int    getFlagHeight(const sFlag* flag);
-bool   isDescForced (const sFlag* flag, int idx);
-bool   isDescLegal  (const sFlag* flag, int idx);
-bool   isDescMasked (const sFlag* flag, int idx);
-bool   isFlagLegal  (const sFlag* flag);
-void   setKeyDispLen(sKey* keys, size_t dispWidth);
+sFlag* addFlag        (sFlagList* list, const char* name, int line, int ndesc, const char state[2]);
+sFlag* addFlagRef     (sFlagList* list, sArena** arena, char* name, int line, int ndesc, const char state[2]);
+size_t addFlagDesc    (sFlag* flag, const char* pkg, const char* desc, const char* desc_alt, const char state[6]);
+int    addFlagRows    (sRowTable* table, const sFlag* flag, int idx);
+void*  arenaAlloc     (sArena** arena, size_t size);
+void   buildNameIndex (sNameIndex* index, const sFlagList* list);
+void   destroyArena   (sArena** arena);
+void   destroyFlagList(sFlagList* list);
+void   destroyLineIndex(sLineIndex* index);
+void   destroyNameIndex(sNameIndex* index);
+void   destroyRowTable(sRowTable* table);
+void   destroyWrapLayouts(void);
+int    findNameMatch  (const sNameIndex* index, const sFlagList* list, int lo, int hi, int after);
+void   genFlagStats   (sFlag* flag);
+const
+sDescText* getDescText(sDesc* desc);
+int    getFlagAtLine  (const sLineIndex* index, int line);
+int    getFlagHeight  (const sFlag* flag);
+int    getLineCount   (const sLineIndex* index);
+int    getLineOfFlag  (const sLineIndex* index, int idx);
+bool   isDescForced   (const sFlag* flag, int idx);
+bool   isDescLegal    (const sFlag* flag, int idx);
+bool   isDescMasked   (const sFlag* flag, int idx);
+bool   isFlagLegal    (const sFlag* flag);
+int    narrowNameRange(const sNameIndex* index, const sFlagList* list, int pos, char c, int* lo, int* hi);
+void   reserveFlags   (sFlagList* list, int count);
+void   resetLineIndex (sLineIndex* index, int size);
+void   setKeyDispLen  (sKey* keys, size_t dispWidth);
+void   setLineHeight  (sLineIndex* index, int idx, int height);
+void   wrapFlags      (sFlagList* list, int first);
 
 #endif /* UFED_TYPES_H_INCLUDED */
@@ -0,0 +1,272 @@
+/*
+ * ufed-curses-vdb.c
+ *
+ *  Native scanner of the installed packages database (/var/db/pkg)
+ */
+
+/* openat() and friends are POSIX.1-2008 */
+#undef  _XOPEN_SOURCE
+#define _XOPEN_SOURCE 700
+
+#include "ufed-curses-vdb.h"
+#include "ufed-curses.h"
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/** @brief maximum number of worker threads reading categories
+ *  This is about I/O depth, not CPU count, so it is fixed.
+**/
+#define VDB_MAX_WORKERS 8
+
+
+/* internal types */
+
+/** @struct sVdbCat_
+ *  @brief result buffer of one scanned category
+**/
+typedef struct sVdbCat_ {
+	const char* name; //!< name of the category
+	char*       out;  //!< lines to print, NULL if the category can not be read
+	size_t      len;  //!< used length of out
+	size_t      size; //!< allocated size of out
+} sVdbCat;
+
+
+/* internal members */
+static sVdbCat*        cats     = NULL;
+static int             catCount = 0;
+static int             catNext  = 0;
+static int             vdbFd    = -1;
+static pthread_mutex_t vdbLock  = PTHREAD_MUTEX_INITIALIZER;
+
+/* internal prototypes */
+static void  addSig      (sVdbCat* cat, int dirFd, const char* name);
+static void  addStr      (sVdbCat* cat, const char* str, size_t len);
+static int   fmtStat     (char* buf, size_t size, const struct stat* st);
+static void  readIuse    (sVdbCat* cat, int pkgFd);
+static void  scanCategory(sVdbCat* cat);
+static void* scanWorker  (void* unused);
+
+
+/* function implementations */
+
+/** @brief scan categories of the vdb and print their installed packages
+ *  For each category that can be read, the following is printed to stdout:
+ *  "C\t<category>\t<signature>\n", followed by one line
+ *  "P\t<package-version>\t<signature>\t<IUSE>\n" per installed package.
+ *  A signature is "inode:size:mtime:ctime" of the directory with fractional
+ *  times, exactly as Portage.pm _get_signature() makes it. The categories
+ *  are read by a pool of worker threads, but printed in the order they
+ *  were given.
+ *  @param[in] vdb path to the vdb, normally EPREFIX/var/db/pkg.
+ *  @param[in] count number of categories in @a names.
+ *  @param[in] names names of the categories to scan.
+ *  @return EXIT_SUCCESS or EXIT_FAILURE if the vdb can not be opened.
+**/
+int scanVdb(const char* vdb, int count, char* const names[])
+{
+	pthread_t workers[VDB_MAX_WORKERS];
+	int       workerCount = min(count, VDB_MAX_WORKERS);
+	int       started     = 0;
+
+	vdbFd = open(vdb, O_RDONLY | O_DIRECTORY);
+	if (vdbFd < 0) {
+		fprintf(stderr, "Unable to open %s: %s\n", vdb, strerror(errno));
+		return EXIT_FAILURE;
+	}
+
+	cats = (sVdbCat*)calloc(count > 0 ? count : 1, sizeof(sVdbCat));
+	if (NULL == cats)
+		ERROR_EXIT(-1, "Unable to allocate %lu bytes for vdb scan\n",
+			sizeof(sVdbCat) * count)
+	catCount = count;
+	for (int i = 0; i < count; ++i)
+		cats[i].name = names[i];
+
+	// Start the workers, doing the work here if no thread can be created
+	while ( (started < workerCount)
+		 && (0 == pthread_create(&workers[started], NULL, scanWorker, NULL)) )
+		++started;
+	if (0 == started)
+		scanWorker(NULL);
+	for (int i = 0; i < started; ++i)
+		pthread_join(workers[i], NULL);
+
+	for (int i = 0; i < count; ++i) {
+		if (cats[i].out) {
+			fwrite(cats[i].out, 1, cats[i].len, stdout);
+			free(cats[i].out);
+		}
+	}
+	free(cats);
+	close(vdbFd);
+
+	return fflush(stdout) ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+
+/* internal function implementations */
+
+/** @brief append "\t<signature>" of an entry below @a dirFd to the output of @a cat
+ *  This must produce exactly what _get_signature() in Portage.pm returns.
+**/
+static void addSig(sVdbCat* cat, int dirFd, const char* name)
+{
+	struct stat st;
+	char        sig[192];
+	int         len = 1;
+
+	sig[0] = '\t';
+	if (fstatat(dirFd, name, &st, AT_SYMLINK_NOFOLLOW)) {
+		sig[len++] = '-';
+	} else {
+		len += fmtStat(sig + len, sizeof(sig) - len, &st);
+		if (S_ISLNK(st.st_mode)) {
+			sig[len++] = '>';
+			if (fstatat(dirFd, name, &st, 0))
+				sig[len++] = '-';
+			else
+				len += fmtStat(sig + len, sizeof(sig) - len, &st);
+		}
+	}
+	addStr(cat, sig, len);
+}
+
+
+/** @brief append @a len bytes of @a str to the output of @a cat
+**/
+static void addStr(sVdbCat* cat, const char* str, size_t len)
+{
+	if ((cat->len + len) > cat->size) {
+		size_t newSize = cat->size ? cat->size : 4096;
+		while (newSize < (cat->len + len))
+			newSize *= 2;
+		char* newOut = (char*)realloc(cat->out, newSize);
+		if (NULL == newOut)
+			ERROR_EXIT(-1, "Unable to allocate %lu bytes for vdb scan\n", newSize)
+		cat->out  = newOut;
+		cat->size = newSize;
+	}
+	memcpy(cat->out + cat->len, str, len);
+	cat->len += len;
+}
+
+
+/** @brief write "inode:size:mtime:ctime" of @a st to @a buf
+ *  The times are the seconds since the epoch with their fraction, added
+ *  up and printed like Time::HiRes::stat() values are stringified by Perl.
+ *  @return the number of characters written.
+**/
+static int fmtStat(char* buf, size_t size, const struct stat* st)
+{
+	double mtime = (double)st->st_mtim.tv_sec + (double)st->st_mtim.tv_nsec / 1e9;
+	double ctime = (double)st->st_ctim.tv_sec + (double)st->st_ctim.tv_nsec / 1e9;
+
+	return snprintf(buf, size, "%lu:%lld:%.15g:%.15g",
+			(unsigned long)st->st_ino, (long long)st->st_size, mtime, ctime);
+}
+
+
+/** @brief append "\t<IUSE>" of the package directory @a pkgFd to @a cat
+ *  IUSE is read with as few read() calls as possible, and all whitespace is
+ *  normalized to single blanks.
+**/
+static void readIuse(sVdbCat* cat, int pkgFd)
+{
+	char    buf[8192];
+	bool    inWord = false;
+	ssize_t got;
+	int     fd = openat(pkgFd, "IUSE", O_RDONLY);
+
+	addStr(cat, "\t", 1);
+	if (fd < 0)
+		return;
+
+	while ((got = read(fd, buf, sizeof(buf))) > 0) {
+		ssize_t start = 0;
+		for (ssize_t i = 0; i < got; ++i) {
+			if ((' ' == buf[i]) || ('\t' == buf[i]) || ('\n' == buf[i])) {
+				if (inWord)
+					addStr(cat, buf + start, i - start);
+				inWord = false;
+			} else if (!inWord) {
+				if (cat->len && ('\t' != cat->out[cat->len - 1]))
+					addStr(cat, " ", 1);
+				start  = i;
+				inWord = true;
+			}
+		}
+		if (inWord)
+			addStr(cat, buf + start, got - start);
+	}
+	close(fd);
+}
+
+
+/** @brief read all packages of one category into its output buffer
+**/
+static void scanCategory(sVdbCat* cat)
+{
+	int            catFd = openat(vdbFd, cat->name, O_RDONLY | O_DIRECTORY);
+	DIR*           dir   = NULL;
+	struct dirent* ent   = NULL;
+
+	if ( (catFd < 0) || (NULL == (dir = fdopendir(catFd))) ) {
+		if (catFd >= 0)
+			close(catFd);
+		return;
+	}
+
+	addStr(cat, "C\t", 2);
+	addStr(cat, cat->name, strlen(cat->name));
+	addSig(cat, vdbFd, cat->name);
+	addStr(cat, "\n", 1);
+
+	while ((ent = readdir(dir))) {
+		if ( !strcmp(ent->d_name, ".") || !strcmp(ent->d_name, "..") )
+			continue;
+
+		addStr(cat, "P\t", 2);
+		addStr(cat, ent->d_name, strlen(ent->d_name));
+		addSig(cat, catFd, ent->d_name);
+
+		int pkgFd = openat(catFd, ent->d_name, O_RDONLY | O_DIRECTORY);
+		if (pkgFd >= 0) {
+			readIuse(cat, pkgFd);
+			close(pkgFd);
+		} else
+			addStr(cat, "\t", 1);
+		addStr(cat, "\n", 1);
+	}
+	closedir(dir);
+}
+
+
+/** @brief worker thread taking the next unscanned category until all are done
+**/
+static void* scanWorker(void* unused)
+{
+	(void)unused;
+
+	for (;;) {
+		int idx;
+
+		pthread_mutex_lock(&vdbLock);
+		idx = catNext < catCount ? catNext++ : -1;
+		pthread_mutex_unlock(&vdbLock);
+
+		if (idx < 0)
+			break;
+		scanCategory(&cats[idx]);
+	}
+
+	return NULL;
+}
@@ -0,0 +1,7 @@
+#pragma once
+#ifndef UFED_CURSES_VDB_H_INCLUDED
+#define UFED_CURSES_VDB_H_INCLUDED
+
+int scanVdb(const char* vdb, int count, char* const names[]);
+
+#endif /* UFED_CURSES_VDB_H_INCLUDED */
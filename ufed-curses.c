@@ -1,63 +1,328 @@
 #include "ufed-curses.h"
 
 #include <errno.h>
+#include <poll.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 #include <unistd.h>
 #include <locale.h>
 
+/** @brief longest time in ms held navigation keys may go without a screen update
+**/
+#define FRAME_MSEC 40
+
+/** @brief signature flag index of a line that must be drawn in any case
+**/
+#define ROW_SIG_DIRTY -2
+
+/** @brief signature flag index of a line that is blank below the list
+**/
+#define ROW_SIG_BLANK -1
+
+
+/* internal types */
+
+/** @struct sRowSig_
+ *  @brief what one line of List showed when it was drawn last
+ *  drawFlags() leaves the lines of a flag alone if none of their
+ *  signatures changed.
+**/
+typedef struct sRowSig_ {
+	int          desc;      //!< index of the description drawn
+	int          flag;      //!< index of the flag drawn, or ROW_SIG_DIRTY or ROW_SIG_BLANK
+	bool         hasHead;   //!< true if the flag name was drawn on this line
+	bool         highlight; //!< true if the flag was drawn as the current one
+	char         state;     //!< the configured state of the flag when drawn
+	const sWrap* wrap;      //!< the wrapped part drawn
+} sRowSig;
+
+
 /* internal members */
 static const char* subtitle = NULL;
-static sKey*  keys          = NULL;
-static sFlag* currentflag   = NULL;
-static sFlag* flags         = NULL;
-static bool   withSep       = false;
+static sKey*      keys      = NULL;
+static int        current   = 0;    // Index of the current flag
+static sFlagList* flags     = NULL;
+static int        loadFd    = -1;
+static bool       withSep   = false;
 
 // Needed for the scrollbar and its mouse events
 static int listHeight, barStart, barEnd, dispStart, dispEnd;
 
+/* The visible lines of the flags and the settings they were counted with.
+ * Whenever the list or one of the settings changes, the index and the
+ * table of rows drawn on these lines are rebuilt.
+ */
+static sLineIndex lineIndex = { 0, NULL, 0, NULL };
+static sRowTable  rowTable  = { 0, NULL, 0 };
+static struct {
+	const sFlagList* list;
+	const sFlag*     flag;
+	eDesc            desc;
+	eMask            mask;
+	eOrder           order;
+	eScope           scope;
+	eState           state;
+	int              width;
+	eWrap            wrap;
+} lineKey = { NULL, NULL, eDesc_ori, eMask_unmasked, eOrder_left, eScope_all, eState_all, 0, eWrap_normal };
+
+/* The signatures of the lines of List and the settings they are valid
+ * with. Whenever one of the settings changes, all lines are dirty.
+ */
+static sRowSig* rowSig    = NULL;
+static int      rowSigLen = 0;
+static struct {
+	const sFlagList* list;
+	eDesc            desc;
+	int              minwidth;
+	eOrder           order;
+	int              width;
+} sigKey = { NULL, eDesc_ori, 0, eOrder_left, 0 };
+
 
 /* internal prototypes */
-static int (*callback)(sFlag**, int);
-static int (*drawflag)(sFlag*, bool);
+static int (*callback)(int*, int);
+static void (*drawflag)(sFlag*, int, const sRow*, int, bool);
+static bool (*loader)(void);
 static void checktermsize(void);
+static void drawFrame(bool withSep);
+static void drawListStatus(void);
 static void drawScrollbar(void);
-static int  getListHeight(void);
+static int  findFlagAt(int line);
+static int  getkey(void);
+static long getMsec(void);
+static bool hasInput(void);
+static bool hasRowSigs(int line, const sRow* row, int count, bool highlight);
+static void scrollFlags(int count);
+static void setRowSigs(int line, const sRow* row, int count, bool highlight);
+static void updateLineIndex(void);
+static void updateRowSigs(void);
+
+/* internal inline functions */
+static inline sFlag* getFlag(int idx) { return &flags->flag[idx]; }
+static inline int    getLine(int idx) { return getLineOfFlag(&lineIndex, idx); }
 
 
 /* internal functions */
 
-/** @brief get the sum of lines the list holds respecting current filtering
+/** @brief draw the borders, Top and Bottom
+ *  The windows are not fully refreshed!
+ *  @param withSep draw status separators if set to true
+ */
+static void drawFrame(bool withSep)
+{
+	WINDOW *w = win(Left);
+
+	/* A touched stdscr covers List, whose unchanged lines must
+	 * then be copied again, as drawFlags() does not redraw them.
+	 */
+	if (is_wintouched(stdscr))
+		touchwin(win(List));
+	wnoutrefresh(stdscr);
+
+	wattrset(w, COLOR_PAIR(2) | A_BOLD);
+	mvwvline(w, 0, 0, ACS_VLINE, wHeight(Left));
+	wattrset(w, COLOR_PAIR(3));
+	mvwvline(w, 0, 1, ' ',       wHeight(Left));
+	mvwvline(w, 0, 2, ACS_VLINE, wHeight(Left));
+	wnoutrefresh(w);
+
+	w = win(Right);
+	wattrset(w, COLOR_PAIR(2) | A_BOLD);
+	mvwvline(w, 0, 0, ' ',       wHeight(Right));
+	mvwvline(w, 0, 1, ACS_VLINE, wHeight(Right));
+	wnoutrefresh(w);
+
+	drawTop(withSep);
+	drawBottom(withSep);
+}
+
+
+/** @brief show the filter status or, while the list is still read, the
+ *  loading progress right of the status separators
+ *  The window is not fully refreshed!
+ */
+static void drawListStatus()
+{
+	WINDOW* w      = win(Input);
+	int     iWidth = wWidth(Input);
+	char    buf[COLS + 1];
+
+	if (flagsLoaded < flagsTotal) {
+		char progress[64];
+		sprintf(progress, " [loading %d/%d flags] ", flagsLoaded, flagsTotal);
+		sprintf(buf, "%*.*s", max(0, iWidth - minwidth - 8), max(0, iWidth - minwidth - 8), progress);
+	} else {
+		/* Use the unused right side to show the filter status
+		 * The Order and layout is:
+		 * [Scope|State|Mask|Order|Desc] with
+		 * all items limited to four characters.
+		 * 5 * 4 = 20
+		 * + 2 brackets = 22
+		 * + 4 pipes    = 26
+		*/
+		sprintf(buf, "%*s%-4s|%-4s|%-4s|%-4s|%-4s|%-4s] ",
+			max(2, iWidth - 38 - minwidth), " [",
+			eScope_global         == e_scope ? "glob"
+			: eScope_local        == e_scope ? "loca" : "all",
+			eState_installed      == e_state ? "inst"
+			: eState_notinstalled == e_state ? "noti" : "all",
+			eMask_masked          == e_mask  ? "mask"
+			: eMask_unmasked      == e_mask  ? "norm" : "all",
+			eOrder_left           == e_order ? "left" : "righ",
+			eDesc_ori             == e_desc  ? "orig" : "stri",
+			eWrap_normal          == e_wrap  ? "long" : "wrap");
+	}
+
+	wattrset(w, COLOR_PAIR(3));
+	mvwaddstr(w, 0, minwidth + 8, buf);
+	wmove(w, 0, strlen(fayt));
+	wnoutrefresh(w);
+}
+
+
+/** @brief find the first not filtered flag starting at or below visible line @a line
+ *  @return the index of the flag, or flags->count if there is none.
+**/
+static int findFlagAt(int line)
+{
+	int idx = getFlagAtLine(&lineIndex, max(line, 0));
+
+	if ( (idx < flags->count) && (getLine(idx) < line) )
+		idx = getFlagAtLine(&lineIndex, getLine(idx + 1));
+
+	return idx;
+}
+
+
+/** @brief wait for the next key while feeding the loader, if any
+ *  As long as a loader is set, the keyboard and its file descriptor are
+ *  watched. Whenever the loader got more flags, the list, the scrollbar and
+ *  the loading progress are updated.
+ *  @return the key as returned by getch()
+**/
+static int getkey()
+{
+	while (loadFd >= 0) {
+		struct pollfd fds[2] = {
+			{ STDIN_FILENO, POLLIN, 0 },
+			{ loadFd,       POLLIN, 0 }
+		};
+		int ready = poll(fds, 2, -1);
+
+		if ( (ready < 0) && (EINTR != errno) )
+			ERROR_EXIT(-1, "Waiting for input failed with error %d\n", errno)
+
+		if (fds[1].revents) {
+			if (!loader())
+				loadFd = -1;
+			drawFlags();
+			drawScrollbar();
+			if (withSep)
+				drawListStatus();
+			doupdate();
+		}
+
+		// A signal like SIGWINCH might have a key pending, too.
+		if ( fds[0].revents || (ready < 0) ) {
+			nodelay(stdscr, TRUE);
+			int c = getch();
+			nodelay(stdscr, FALSE);
+			if (ERR != c)
+				return c;
+		}
+	}
+
+	return getch();
+}
+
+
+/// @brief return the milliseconds of a monotonic clock
+static long getMsec()
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (long)now.tv_sec * 1000 + now.tv_nsec / 1000000;
+}
+
+
+/// @brief return true if more keys are waiting to be read
+static bool hasInput()
+{
+	struct pollfd fds = { STDIN_FILENO, POLLIN, 0 };
+	return poll(&fds, 1, 0) > 0;
+}
+
+
+/** @brief return true if the @a count lines from @a line on still show @a row on
+ *  The first line of a flag always carries its name, and the current flag
+ *  is highlighted, so both are part of the signature. Everything else a
+ *  line shows only depends on its row, the configured state of its flag
+ *  and the settings in sigKey.
 **/
-static int getListHeight()
+static bool hasRowSigs(int line, const sRow* row, int count, bool highlight)
 {
-	int result = 0;
-
-	// Add masked lines
-	if (eMask_masked != e_mask) {
-		if (eState_installed != e_state)
-			result += listStats.lineCountMasked;
-		if (eState_notinstalled != e_state)
-			result += listStats.lineCountMaskedInstalled;
+	for (int i = 0; i < count; ++i, ++row) {
+		const sRowSig* sig = &rowSig[line + i];
+		if ( (sig->flag      != row->flag)
+		  || (sig->desc      != row->desc)
+		  || (sig->wrap      != row->wrap)
+		  || (sig->hasHead   != (0 == i))
+		  || (sig->highlight != highlight)
+		  || (sig->state     != getFlag(row->flag)->stateConf) )
+			return false;
 	}
 
-	// Add global lines
-	if (eScope_local != e_scope) {
-		if (eState_installed != e_state)
-			result += listStats.lineCountGlobal;
-		if (eState_notinstalled != e_state)
-			result += listStats.lineCountGlobalInstalled;
+	return true;
+}
+
+
+/** @brief scroll List and the signatures of its lines by @a count lines
+ *  Positive values scroll towards the end of the list. Only the lines
+ *  scrolled in are dirty afterwards. With idlok() set on List, curses
+ *  can scroll the terminal instead of sending the moved lines again.
+**/
+static void scrollFlags(int count)
+{
+	WINDOW* wLst    = win(List);
+	int     lHeight = wHeight(List);
+	int     kept    = lHeight - abs(count);
+
+	if (kept <= 0) {
+		touchFlags();
+		return;
 	}
 
-	// Add local lines
-	if (eScope_global != e_scope) {
-		if (eState_installed != e_state)
-			result += listStats.lineCountLocal;
-		if (eState_notinstalled != e_state)
-			result += listStats.lineCountLocalInstalled;
+	scrollok(wLst, TRUE);
+	wscrl(wLst, count);
+	scrollok(wLst, FALSE);
+
+	if (count > 0) {
+		memmove(rowSig, rowSig + count, sizeof(sRowSig) * kept);
+		for (int i = kept; i < lHeight; ++i)
+			rowSig[i].flag = ROW_SIG_DIRTY;
+	} else {
+		memmove(rowSig - count, rowSig, sizeof(sRowSig) * kept);
+		for (int i = 0; i < -count; ++i)
+			rowSig[i].flag = ROW_SIG_DIRTY;
 	}
+}
 
-	return result;
+
+/** @brief note that the @a count lines from @a line on show @a row on
+**/
+static void setRowSigs(int line, const sRow* row, int count, bool highlight)
+{
+	for (int i = 0; i < count; ++i, ++row) {
+		sRowSig* sig = &rowSig[line + i];
+		sig->desc      = row->desc;
+		sig->flag      = row->flag;
+		sig->hasHead   = (0 == i);
+		sig->highlight = highlight;
+		sig->state     = getFlag(row->flag)->stateConf;
+		sig->wrap      = row->wrap;
+	}
 }
 
 
@@ -81,6 +346,7 @@ void initcurses() {
 	{ eWin w; for(w = (eWin) 0; w != wCount; w++) {
 		window[w].win = newwin(wHeight(w), wWidth(w), wTop(w), wLeft(w));
 	} }
+	idlok(win(List), TRUE); // Let the terminal scroll, see scrollFlags()
 }
 
 void cursesdone() {
@@ -88,6 +354,12 @@ void cursesdone() {
 	for(w = (eWin) 0; w != wCount; w++)
 		delwin(window[w].win);
 	endwin();
+	destroyLineIndex(&lineIndex);
+	destroyRowTable(&rowTable);
+	if (rowSig)
+		free(rowSig);
+	rowSig    = NULL;
+	rowSigLen = 0;
 }
 
 static void checktermsize() {
@@ -191,6 +463,28 @@ void drawBottom(bool withSep)
 }
 
 
+/** @brief redraw the lines of flag @a idx that are on the screen
+ *  The window is not fully refreshed!
+ *  @param idx index of the flag to draw
+ *  @param highlight draw the flag as the current one if true
+ */
+void drawFlag(int idx, bool highlight)
+{
+	int lHeight = wHeight(List);
+
+	updateLineIndex();
+
+	int first = max(getLine(idx), dispStart);
+	int end   = min(getLine(idx + 1), dispStart + lHeight);
+
+	if (first < end) {
+		updateRowSigs();
+		drawflag(getFlag(idx), first - dispStart, &rowTable.row[first], end - first, highlight);
+		setRowSigs(first - dispStart, &rowTable.row[first], end - first, highlight);
+	}
+}
+
+
 void drawFlags() {
 	WINDOW* wLst    = win(List);
 	int     lHeight = wHeight(List);
@@ -199,71 +493,79 @@ void drawFlags() {
 	/* this method must not be called if the current
 	 * item is not valid.
 	 */
-	if (!isFlagLegal(currentflag))
+	if (!isFlagLegal(getFlag(current)))
 		ERROR_EXIT(-1,
 			"drawflags() must not be called with a filtered currentflag! (topline %d listline %d)\n",
-			topline, currentflag->listline)
+			topline, getFlag(current)->listline)
 
-	sFlag* flag = currentflag;
-	sFlag* last = currentflag;
+	updateLineIndex();
 
 	/* lHeight - flagHeight are compared against listline - topline,
 	 * because the latter can result in a too large value if a
 	 * strong limiting filter (like "masked") has just been turned
 	 * off.
 	 */
-	int line = flag->listline - topline;
+	int line = getFlag(current)->listline - topline;
 	if (line > lHeight)
-		line = lHeight - getFlagHeight(flag);
-
-	/* move to the top of the displayed list */
-	while ((flag != flags) && (line > 0)) {
-		flag = flag->prev;
-		if (isFlagLegal(flag)) {
-			line -= getFlagHeight(flag);
-			last = flag;
-		}
-	}
+		line = lHeight - getFlagHeight(getFlag(current));
 
-	/* If the above move ended up with flag == flags
-	 * topline and line must be adapted to the last
-	 * found not filtered flag.
+	/* If the list does not reach up to the top line,
+	 * topline must be adapted to show the first not
+	 * filtered flag on top.
 	 * This can happen if the flag filter is toggled
-	 * and the current flag is the first not filtered.
+	 * and the current flag is among the first not filtered.
 	 */
-	if (flag == flags) {
-		if (!isFlagLegal(flag)) {
-			flag    = last;
-			topline = last->listline;
-		}
-		line = 0;
+	int top = getLine(current) - line;
+	if (top < 0) {
+		topline -= top;
+		top      = 0;
 	}
 
-	// The display start line might differ from topline:
-	dispStart = flag->listline;
-
-	for( ; line < lHeight; ) {
-		flag->currline = line; // drawflag() and maineventloop() need this
-		line += drawflag(flag, flag == currentflag ? TRUE : FALSE);
-
-		if (line < lHeight) {
-			flag = flag->next;
-
-			/* Add blank lines if we reached the end of the
-			 * flag list, but not the end of the display.
-			 */
-			if(flag == flags) {
-				wattrset(wLst, COLOR_PAIR(3));
-				while(line < lHeight) {
-					mvwhline(wLst, line, 0, ' ', lWidth);
-					mvwaddch(wLst, line, minwidth,     ACS_VLINE); // Before state
-					mvwaddch(wLst, line, minwidth + 4, ACS_VLINE); // Between state and scope
-					mvwaddch(wLst, line, minwidth + 7, ACS_VLINE); // After scope
-					++line;
-				}
+	/* Only the flags whose lines show something else than
+	 * before are drawn, see hasRowSigs(). If the display
+	 * moved by less than a page, the lines still shown are
+	 * scrolled instead of drawn again.
+	 */
+	updateRowSigs();
+	if (top != dispStart)
+		scrollFlags(top - dispStart);
+
+	// The display is a slice of the row table starting with top:
+	dispStart = top;
+	dispEnd   = top;
+
+	for (line = 0; line < lHeight; ) {
+		/* Add blank lines if we reached the end of the
+		 * flag list, but not the end of the display.
+		 */
+		if ( (top + line) >= rowTable.count) {
+			wattrset(wLst, COLOR_PAIR(3));
+			for ( ; line < lHeight; ++line) {
+				if (ROW_SIG_BLANK == rowSig[line].flag)
+					continue;
+				mvwhline(wLst, line, 0, ' ', lWidth);
+				mvwaddch(wLst, line, minwidth,     ACS_VLINE); // Before state
+				mvwaddch(wLst, line, minwidth + 4, ACS_VLINE); // Between state and scope
+				mvwaddch(wLst, line, minwidth + 7, ACS_VLINE); // After scope
+				rowSig[line].flag = ROW_SIG_BLANK;
 			}
-		} else
-			dispEnd = flag->listline + flag->ndesc;
+			break;
+		}
+
+		const sRow* row       = &rowTable.row[top + line];
+		int         idx       = row->flag;
+		int         count     = 0;
+		bool        highlight = (idx == current);
+
+		dispEnd = getLine(idx + 1);
+		count   = min(dispEnd, top + lHeight) - (top + line);
+
+		getFlag(idx)->currline = getLine(idx) - top; // maineventloop() needs this
+		if (!hasRowSigs(line, row, count, highlight)) {
+			drawflag(getFlag(idx), line, row, count, highlight);
+			setRowSigs(line, row, count, highlight);
+		}
+		line += count;
 	}
 	wmove(win(Input), 0, strlen(fayt));
 	wnoutrefresh(wLst);
@@ -278,15 +580,16 @@ static void drawScrollbar() {
 	wvline(w, ACS_CKBOARD, sHeight - 3);
 
 	/* The scrollbar location differs related to the
-	 * current filtering of masked flags.
+	 * current filtering and wrapping of the flags.
 	 */
-	listHeight = getListHeight();
+	updateLineIndex();
+	listHeight = getLineCount(&lineIndex);
 
 	// Only show a scrollbar if the list is actually longer than can be displayed:
 	if (listHeight > lHeight) {
 		int sbHeight = sHeight - 3;
-		barStart = 1 + (dispStart * sbHeight / bottomline);
-		barEnd   = barStart + ((dispEnd - dispStart) * lHeight / bottomline);
+		barStart = 1 + (dispStart * sbHeight / listHeight);
+		barEnd   = barStart + ((dispEnd - dispStart) * lHeight / listHeight);
 
 		// Strongly filtered lists scatter much and must be corrected:
 		if (barEnd > sbHeight) {
@@ -320,8 +623,6 @@ void drawStatus(bool withSep)
 	mvwhline(w, 0, 0, ' ', withSep ? minwidth : iWidth);
 
 	if (withSep) {
-		char buf[COLS+1];
-
 		// Add Status separators and explenation characters
 		mvwaddch (w, 0, minwidth    , ACS_VLINE); // Before state
 		mvwaddstr(w, 0, minwidth + 1, "DPC");     // Default, Profile, Config
@@ -329,26 +630,7 @@ void drawStatus(bool withSep)
 		mvwaddstr(w, 0, minwidth + 5, "Si");      // Scope, installed
 		mvwaddch (w, 0, minwidth + 7, ACS_VLINE); // After scope
 
-		/* Use the unused right side to show the filter status
-		 * The Order and layout is:
-		 * [Scope|State|Mask|Order|Desc] with
-		 * all items limited to four characters.
-		 * 5 * 4 = 20
-		 * + 2 brackets = 22
-		 * + 4 pipes    = 26
-		*/
-		sprintf(buf, "%*s%-4s|%-4s|%-4s|%-4s|%-4s|%-4s] ",
-			max(2, iWidth - 38 - minwidth), " [",
-			eScope_global         == e_scope ? "glob"
-			: eScope_local        == e_scope ? "loca" : "all",
-			eState_installed      == e_state ? "inst"
-			: eState_notinstalled == e_state ? "noti" : "all",
-			eMask_masked          == e_mask  ? "mask"
-			: eMask_unmasked      == e_mask  ? "norm" : "all",
-			eOrder_left           == e_order ? "left" : "righ",
-			eDesc_ori             == e_desc  ? "orig" : "stri",
-			eWrap_normal          == e_wrap  ? "long" : "wrap");
-		waddstr(w, buf);
+		drawListStatus();
 	}
 
 	// Reset cursor and apply changes
@@ -420,27 +702,9 @@ void drawTop(bool withSep)
  *  @param withSep draw status separators if set to true
  */
 void draw(bool withSep) {
-	WINDOW *w = win(Left);
-
-	wnoutrefresh(stdscr);
-
-	wattrset(w, COLOR_PAIR(2) | A_BOLD);
-	mvwvline(w, 0, 0, ACS_VLINE, wHeight(Left));
-	wattrset(w, COLOR_PAIR(3));
-	mvwvline(w, 0, 1, ' ',       wHeight(Left));
-	mvwvline(w, 0, 2, ACS_VLINE, wHeight(Left));
-	wnoutrefresh(w);
+	drawFrame(withSep);
 
-	w = win(Right);
-	wattrset(w, COLOR_PAIR(2) | A_BOLD);
-	mvwvline(w, 0, 0, ' ',       wHeight(Right));
-	mvwvline(w, 0, 1, ACS_VLINE, wHeight(Right));
-	wnoutrefresh(w);
-
-	drawTop(withSep);
-	drawBottom(withSep);
-
-	if (flags) {
+	if (flags && flags->count) {
 		drawFlags();
 		drawScrollbar();
 	}
@@ -448,9 +712,47 @@ void draw(bool withSep) {
 	drawStatus(withSep);
 }
 
+/** @brief draw the frame with @a msg as status while no list can be shown yet
+ *  @param _subtitle the subtitle maineventloop() will be called with
+ *  @param msg the message to show in the status line
+ */
+void drawLoading(const char* _subtitle, const char* msg) {
+	WINDOW* w = win(Input);
+
+	subtitle = _subtitle;
+	drawFrame(false);
+	subtitle = NULL;
+	touchFlags();
+
+	{ eWin e[2] = { List, Scrollbar }; for (int i = 0; i < 2; ++i) {
+		wbkgdset(win(e[i]), COLOR_PAIR(3));
+		werase(win(e[i]));
+		wnoutrefresh(win(e[i]));
+	} }
+
+	wattrset(w, COLOR_PAIR(3));
+	mvwhline(w, 0, 0, ' ', wWidth(Input));
+	wattrset(w, COLOR_PAIR(5) | A_BOLD);
+	mvwaddstr(w, 0, 0, msg);
+	wrefresh(w);
+}
+
+/** @brief check the terminal size and recreate all windows
+ *  This is needed whenever the terminal or the minimum width changed.
+ */
+void resizecurses() {
+	checktermsize();
+	{ eWin w; for(w = (eWin) 0; w != wCount; w++) {
+		delwin(window[w].win);
+		window[w].win = newwin(wHeight(w), wWidth(w), wTop(w), wLeft(w));
+	} }
+	idlok(win(List), TRUE);
+	touchFlags();
+}
+
 bool scrollcurrent() {
-	int lsLine = currentflag->listline;
-	int flHeight = getFlagHeight(currentflag);
+	int lsLine = getFlag(current)->listline;
+	int flHeight = getFlagHeight(getFlag(current));
 	int btLine   = lsLine + flHeight;
 	int wdHeight = wHeight(List);
 
@@ -492,12 +794,7 @@ bool yesno(const char *prompt) {
 				break;
 #ifdef KEY_RESIZE
 		case KEY_RESIZE:
-				resizeterm(LINES, COLS);
-				checktermsize();
-				{ eWin w; for(w = (eWin) 0; w != wCount; w++) {
-					delwin(window[w].win);
-					window[w].win = newwin(wHeight(w), wWidth(w), wTop(w), wLeft(w));
-				} }
+				resizecurses();
 
 				/* this won't work for the help viewer, but it doesn't use yesno() */
 				topline = 0;
@@ -517,9 +814,9 @@ bool yesno(const char *prompt) {
 
 int maineventloop(
 		const char *_subtitle,
-		int(*_callback)(sFlag**, int),
-		int(*_drawflag)(sFlag*, bool),
-		sFlag* _flags,
+		int(*_callback)(int*, int),
+		void(*_drawflag)(sFlag*, int, const sRow*, int, bool),
+		sFlagList* _flags,
 		sKey *_keys,
 		bool _withSep) {
 	int result;
@@ -527,13 +824,13 @@ int maineventloop(
 	{ const char *temp = subtitle;
 		subtitle  = _subtitle;
 		_subtitle = temp; }
-	{ int(*temp)(sFlag**, int) = callback;
+	{ int(*temp)(int*, int) = callback;
 		callback  = _callback;
 		_callback = temp; }
-	{ int(*temp)(sFlag*, bool) = drawflag;
+	{ void(*temp)(sFlag*, int, const sRow*, int, bool) = drawflag;
 		drawflag  = _drawflag;
 		_drawflag = temp; }
-	{ sFlag* temp = flags;
+	{ sFlagList* temp = flags;
 		flags  = _flags;
 		_flags = temp; }
 	{ sKey *temp = keys;
@@ -541,26 +838,30 @@ int maineventloop(
 		_keys = temp; }
 
 	// Save old display position
-	sFlag* oldCurr = currentflag;
-	bool   oldSep  = withSep;
-	int    oldTop  = topline;
-	currentflag    = flags;
-	topline        = 0;
-	withSep        = _withSep;
+	int  oldCurr = current;
+	bool oldSep  = withSep;
+	int  oldTop  = topline;
+	current      = 0;
+	topline      = 0;
+	withSep      = _withSep;
 
 	// Save filter settings and start with neutral ones
 	eMask  oldMask  = e_mask;
 	eScope oldScope = e_scope;
 	eState oldState = e_state;
+	eWrap  oldWrap  = e_wrap;
 	e_mask  = eMask_unmasked;
 	e_scope = eScope_all;
 	e_state = eState_all;
+	e_wrap  = eWrap_normal;
 
 	// Draw initial display
 	draw(withSep);
 
+	long lastUpdate = getMsec();
 	for(;;) {
-		int c = getch();
+		bool isMove = false;
+		int  c      = getkey();
 #ifndef NCURSES_MOUSE_VERSION
 		if(c==ERR)
 			continue;
@@ -586,29 +887,22 @@ int maineventloop(
 				}
 				if(wmouse_trafo(win(List), &event.y, &event.x, FALSE)) {
 					if(event.bstate & (BUTTON1_CLICKED | BUTTON1_DOUBLE_CLICKED)) {
-						sFlag* flag = currentflag;
-						if(currentflag->currline > event.y) {
-							do flag = flag->prev;
-							while((flag == flags ? flag = NULL, 0 : 1)
-							 && flag->currline > event.y);
-						} else if(currentflag->currline + getFlagHeight(currentflag) - 1 < event.y) {
-							do flag = flag->next;
-							while((flag->next == flags ? flag = NULL, 0 : 1)
-							 && flag->currline + getFlagHeight(flag) - 1 < event.y);
-						}
-						if(flag == NULL)
+						updateLineIndex();
+						int idx = getFlagAtLine(&lineIndex,
+						                        getLine(current) - getFlag(current)->currline + event.y);
+						if(idx >= flags->count)
 							continue;
-						drawflag(currentflag, FALSE);
-						currentflag = flag;
+						drawFlag(current, FALSE);
+						current = idx;
 						if(event.bstate & BUTTON1_DOUBLE_CLICKED) {
-							result=callback(&currentflag, KEY_MOUSE);
+							result=callback(&current, KEY_MOUSE);
 							if(result>=0)
 								goto exit;
 						}
 						if (scrollcurrent())
 							drawStatus(withSep);
 						else
-							drawflag(currentflag, TRUE);
+							drawFlag(current, TRUE);
 					}
 				} else if(wmouse_trafo(win(Scrollbar), &event.y, &event.x, FALSE)) {
 					// Only do mouse events if there actually is a scrollbar
@@ -643,15 +937,15 @@ int maineventloop(
 										event.y -= wTop(Scrollbar) + 1;
 										int sbHeight = wHeight(Scrollbar) - 3;
 										if( (event.y >= 0) && (event.y < sbHeight) ) {
-											topline = (event.y * (listHeight - sbHeight + 2) + sbHeight - 1) / sbHeight;
-											while( (currentflag != flags)
-												&& (currentflag->prev->listline >= topline) )
-												currentflag = currentflag->prev;
-											while( (currentflag->next != flags)
-												&& (currentflag->listline < topline) )
-												currentflag = currentflag->next;
-											if( (currentflag->listline + currentflag->ndesc) > (topline + wHeight(List)) )
-												topline = currentflag->listline + currentflag->ndesc - wHeight(List);
+											int line = (event.y * (listHeight - sbHeight + 2) + sbHeight - 1) / sbHeight;
+											updateLineIndex();
+											current = findFlagAt(line);
+											if(current >= flags->count)
+												current = getFlagAtLine(&lineIndex, listHeight - 1);
+											int row = getLine(current) - line;
+											if( (row + getFlagHeight(getFlag(current))) > wHeight(List) )
+												row = wHeight(List) - getFlagHeight(getFlag(current));
+											topline = getFlag(current)->listline - row;
 											drawFlags();
 											drawScrollbar();
 											wrefresh(win(List));
@@ -718,13 +1012,14 @@ int maineventloop(
 		} else
 #endif
 		{
-			result = callback(&currentflag, c);
+			result = callback(&current, c);
 			if(result >= 0)
 				goto exit;
 
 			switch(c) {
 				case KEY_UP:
-					if(currentflag->currline < 0 ) {
+					isMove = true;
+					if(getFlag(current)->currline < 0 ) {
 						--topline;
 						drawFlags();
 						drawScrollbar();
@@ -733,7 +1028,8 @@ int maineventloop(
 					break;
 	
 				case KEY_DOWN:
-					if( (currentflag->currline + getFlagHeight(currentflag)) > wHeight(List) ) {
+					isMove = true;
+					if( (getFlag(current)->currline + getFlagHeight(getFlag(current))) > wHeight(List) ) {
 						++topline;
 						drawFlags();
 						drawScrollbar();
@@ -742,53 +1038,58 @@ int maineventloop(
 					break;
 	
 				case KEY_PPAGE:
-					if(currentflag != flags)
+					isMove = true;
+					if(current > 0)
 						setPrevItem(wHeight(List), false);
 					break;
 	
 				case KEY_NPAGE:
-					if(currentflag->next != flags)
+					isMove = true;
+					if(current < (flags->count - 1))
 						setNextItem(wHeight(List), false);
 					break;
 	
 				case KEY_HOME:
-					if(currentflag != flags)
+					if(current > 0)
 						resetDisplay(withSep);
 					break;
 	
 				case KEY_END:
-					if(currentflag->next != flags) {
-						drawflag(currentflag, FALSE);
-						currentflag = flags->prev;
-						while (!isFlagLegal(currentflag))
-							currentflag = currentflag->prev;
+					if(current < (flags->count - 1)) {
+						updateLineIndex();
+						drawFlag(current, FALSE);
+						current = getFlagAtLine(&lineIndex, max(getLineCount(&lineIndex) - 1, 0));
+						if (current >= flags->count)
+							current = flags->count - 1;
 						scrollcurrent();
-						drawflag(currentflag, TRUE);
+						drawFlag(current, TRUE);
 					}
 					break;
 
 #ifdef KEY_RESIZE
 				case KEY_RESIZE:
-					resizeterm(LINES, COLS);
-					checktermsize();
-					{ eWin w; for(w = (eWin) 0; w != wCount; w++) {
-						delwin(window[w].win);
-						window[w].win = newwin(wHeight(w), wWidth(w), wTop(w), wLeft(w));
-					} }
-					if(result == -1) {
-						topline = 0;
+					resizecurses();
+					// A result of -2 is a resize in the help
+					// screen, which has re-initialized the
+					// help text lines and the current one.
+					topline = 0;
+					if(result == -1)
 						scrollcurrent();
-					} else
-						// This is the result of a resize in
-						// the help screen, it will re-init
-						// the help text lines.
-						flags = currentflag;
 					draw(withSep);
 					break;
 #endif
 			}
 		}
+
+		/* Held navigation keys queue up faster than a slow terminal
+		 * shows their moves. While more keys are waiting, the moves
+		 * are only drawn into the windows, and the screen is updated
+		 * once for all of them, but at least every FRAME_MSEC.
+		 */
+		if (isMove && hasInput() && ((getMsec() - lastUpdate) < FRAME_MSEC))
+			continue;
 		doupdate();
+		lastUpdate = getMsec();
 	}
 exit:
 	subtitle = _subtitle;
@@ -798,14 +1099,15 @@ exit:
 	keys     = _keys;
 
 	// Reset display:
-	currentflag = oldCurr;
-	topline     = oldTop;
-	withSep     = oldSep;
+	current = oldCurr;
+	topline = oldTop;
+	withSep = oldSep;
 
 	// Revert filters
 	e_mask  = oldMask;
 	e_scope = oldScope;
 	e_state = oldState;
+	e_wrap  = oldWrap;
 
 	if(flags != NULL)
 		draw(withSep);
@@ -819,151 +1121,206 @@ exit:
  */
 void resetDisplay(bool withSep)
 {
-	currentflag = flags;
-	while (!isFlagLegal(currentflag) && (currentflag->next != flags))
-		currentflag = currentflag->next;
-	topline = currentflag->listline;
+	updateLineIndex();
+	current = min(getFlagAtLine(&lineIndex, 0), flags->count - 1);
+	topline = getFlag(current)->listline;
 	draw(withSep);
 }
 
 
-/** @brief set currentflag to the next flag @a count lines away
+/** @brief have @a _loader called by maineventloop() whenever @a fd is readable
+ *  The loader is used until it returns false, meaning everything is read.
+ *  @param fd the file descriptor to watch
+ *  @param _loader the function reading from @a fd
+ */
+void setLoader(int fd, bool (*_loader)(void))
+{
+	loadFd = fd;
+	loader = _loader;
+}
+
+
+/** @brief set the current flag to the next flag @a count lines away
  * @param count set how many lines should be skipped
  * @param strict if set to false, at least one item has to be skipped.
- * @return true if currentflag was changed, flase otherwise
+ * @return true if the current flag was changed, flase otherwise
  */
 bool setNextItem(int count, bool strict)
 {
-	bool   result   = true;
-	sFlag* curr     = currentflag;
-	sFlag* lastFlag = NULL;
-	int    lastTop  = 0;
-	int    skipped  = 0;
-	int    oldTop   = topline;
-	int    fHeight  = 0;
+	bool result  = true;
+	int  curr    = current;
+	int  line    = 0;
+	int  skipped = 0;
 
-	// It is crucial to start with a not filtered flag:
-	while (!isFlagLegal(curr) && (curr->next != flags)) {
-		topline += curr->ndesc;
-		curr     = curr->next;
-	}
+	updateLineIndex();
+	line = getLine(current);
 
-	// Break this if the current item is still filtered
-	if (!isFlagLegal(curr)) {
-		topline = oldTop;
+	// Break this if no flag after the current one is shown
+	if (line >= getLineCount(&lineIndex))
 		return false;
-	}
 
-	while (result && (skipped < count) && (curr->next != flags)) {
-		lastFlag = curr;
-		lastTop  = topline;
-		fHeight  = getFlagHeight(curr);
-		skipped += fHeight;
-		topline += curr->ndesc - fHeight;
-		curr     = curr->next;
-
-		// Ensure a not filtered flag to continue
-		while (!isFlagLegal(curr) && (curr->next != flags)) {
-			topline += curr->ndesc;
-			curr     = curr->next;
-		}
+	/* The current flag might be filtered, then the first flag
+	 * below is the first candidate. Otherwise the wanted flag
+	 * must start at least count lines below the current one.
+	 */
+	curr = findFlagAt(line + count);
 
-		// It is possible to end up with the last flag
-		// which might be filtered:
-		if (curr->next == flags) {
-			if (!isFlagLegal(curr)) {
-				// Revert to last known legal state:
-				curr     = lastFlag;
-				topline  = lastTop;
-				skipped -= getFlagHeight(curr);
-			}
-			// Did we fail ?
-			if (skipped < count)
-				result = false;
-		}
-	} // End of trying to find a next item
+	// If the end is reached, the last shown flag is the best one
+	if (curr >= flags->count) {
+		curr   = getFlagAtLine(&lineIndex, getLineCount(&lineIndex) - 1);
+		result = false;
+	}
+	skipped = getLine(curr) - line;
 
 	if ( (result && strict) || (!strict && skipped) ) {
-		drawflag(currentflag, FALSE);
-		currentflag = curr;
+		/* topline is counted in list lines, which
+		 * include the lines of all filtered flags.
+		 */
+		topline += getFlag(curr)->listline - getFlag(current)->listline
+		         - (getLine(curr) - getLine(current));
+		drawFlag(current, FALSE);
+		current = curr;
 		if (!scrollcurrent())
-			drawflag(currentflag, TRUE);
+			drawFlag(current, TRUE);
 		result = true;
-	} else {
-		topline = oldTop;
-		result  = false;
-	}
+	} else
+		result = false;
 
 	return result;
 }
 
 
-/* @brief set currentflag to the previous item @a count lines away
+/* @brief set the current flag to the previous item @a count lines away
  * @param count set how many lines should be skipped
  * @param strict if set to false, at least one item has to be skipped.
- * @return true if currentflag was changed, flase otherwise
+ * @return true if the current flag was changed, flase otherwise
  */
 bool setPrevItem(int count, bool strict)
 {
-	bool   result   = true;
-	sFlag* curr     = currentflag;
-	sFlag* lastFlag = NULL;
-	int    lastTop  = 0;
-	int    skipped  = 0;
-	int    oldTop   = topline;
-	int    fHeight  = 0;
+	bool result  = true;
+	int  curr    = current;
+	int  line    = 0;
+	int  skipped = 0;
+
+	updateLineIndex();
+	line = getLine(current);
 
 	// It is crucial to start with a not filtered flag:
-	while (!isFlagLegal(curr) && (curr != flags)) {
-		topline -= curr->ndesc;
-		curr     = curr->prev;
+	if (!isFlagLegal(getFlag(curr))) {
+		// Break this if no flag before the current one is shown
+		if (0 == line)
+			return false;
+		curr = getFlagAtLine(&lineIndex, line - 1);
+		line = getLine(curr);
 	}
-	// Break this if the current item is still filtered
-	if (!isFlagLegal(curr)) {
-		topline = oldTop;
-		return false;
-	}
-
-	while (result && (skipped < count) && (curr != flags)) {
-		lastFlag = curr;
-		lastTop  = topline;
-		curr     = curr->prev;
 
-		// Ensure a not filtered flag to continue
-		while (!isFlagLegal(curr) && (curr != flags)) {
-			topline -= curr->ndesc;
-			curr     = curr->prev;
-		}
-
-		fHeight  = getFlagHeight(curr);
-		skipped += fHeight;
-		topline -= curr->ndesc - fHeight;
-
-		// It is possible to end up with the first flag
-		// which might be filtered:
-		if (curr == flags) {
-			if (!isFlagLegal(curr)) {
-				// Revert to last known legal state:
-				skipped -= getFlagHeight(curr);
-				curr     = lastFlag;
-				topline  = lastTop;
-			}
-			// Did we fail ?
-			if (skipped < count)
-				result = false;
-		}
-	} // End of trying to find a next item
+	// The wanted flag is the one shown count lines above
+	if (count > 0) {
+		if (line < count) {
+			curr   = getFlagAtLine(&lineIndex, 0);
+			result = false;
+		} else
+			curr = getFlagAtLine(&lineIndex, line - count);
+	}
+	skipped = getLine(current) - getLine(curr);
 
 	if ( (result && strict) || (!strict && skipped) ) {
-		drawflag(currentflag, FALSE);
-		currentflag = curr;
+		/* topline is counted in list lines, which
+		 * include the lines of all filtered flags.
+		 */
+		topline -= getFlag(current)->listline - getFlag(curr)->listline
+		         - (getLine(current) - getLine(curr));
+		drawFlag(current, FALSE);
+		current = curr;
 		if (!scrollcurrent())
-			drawflag(currentflag, TRUE);
+			drawFlag(current, TRUE);
 		result = true;
-	} else {
-		topline = oldTop;
-		result  = false;
-	}
+	} else
+		result = false;
 
 	return result;
 }
+
+
+/** @brief have all lines of List drawn again by the next drawFlags()
+ *  This is needed whenever something changes that the lines show, but
+ *  which is not part of their signature, like the marks of a search.
+**/
+void touchFlags()
+{
+	for (int i = 0; i < rowSigLen; ++i)
+		rowSig[i].flag = ROW_SIG_DIRTY;
+}
+
+
+/** @brief bring the line index and the row table up to date
+ *  Flags that were added to the list since the last call are appended, any
+ *  change of the list, the filters, the wrapping or the width rebuilds both.
+**/
+static void updateLineIndex()
+{
+	int idx = lineIndex.count;
+
+	if ( (lineKey.list  != flags)
+	  || (lineKey.flag  != flags->flag)
+	  || (lineKey.desc  != e_desc)
+	  || (lineKey.mask  != e_mask)
+	  || (lineKey.order != e_order)
+	  || (lineKey.scope != e_scope)
+	  || (lineKey.state != e_state)
+	  || (lineKey.width != wWidth(List) - (minwidth + 8))
+	  || (lineKey.wrap  != e_wrap)
+	  || (lineIndex.size < flags->size)
+	  || (lineIndex.count > flags->count) ) {
+		lineKey.list  = flags;
+		lineKey.flag  = flags->flag;
+		lineKey.desc  = e_desc;
+		lineKey.mask  = e_mask;
+		lineKey.order = e_order;
+		lineKey.scope = e_scope;
+		lineKey.state = e_state;
+		lineKey.width = wWidth(List) - (minwidth + 8);
+		lineKey.wrap  = e_wrap;
+		resetLineIndex(&lineIndex, flags->size);
+		rowTable.count = 0;
+		idx = 0;
+	}
+
+	wrapFlags(flags, idx);
+	for ( ; idx < flags->count; ++idx)
+		setLineHeight(&lineIndex, idx, addFlagRows(&rowTable, getFlag(idx), idx));
+}
+
+
+/** @brief make sure there is a signature for each line of List
+ *  All lines are dirty if the window changed its height, or if the list,
+ *  the description mode, the order or the widths changed since the last
+ *  call.
+**/
+static void updateRowSigs()
+{
+	int lHeight = wHeight(List);
+
+	if (rowSigLen != lHeight) {
+		sRowSig* sigs = (sRowSig*)realloc(rowSig, sizeof(sRowSig) * lHeight);
+		if (NULL == sigs)
+			ERROR_EXIT(-1, "Unable to allocate %lu bytes for line signatures\n",
+				sizeof(sRowSig) * lHeight)
+		rowSig    = sigs;
+		rowSigLen = lHeight;
+		touchFlags();
+	}
+
+	if ( (sigKey.list     != flags)
+	  || (sigKey.desc     != e_desc)
+	  || (sigKey.minwidth != minwidth)
+	  || (sigKey.order    != e_order)
+	  || (sigKey.width    != wWidth(List)) ) {
+		sigKey.list     = flags;
+		sigKey.desc     = e_desc;
+		sigKey.minwidth = minwidth;
+		sigKey.order    = e_order;
+		sigKey.width    = wWidth(List);
+		touchFlags();
+	}
+}
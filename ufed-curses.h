@@ -6,20 +6,25 @@ void initcurses(void);
 
 void draw(bool withSep);
 void drawBottom(bool withSep);
+void drawFlag(int idx, bool highlight);
 void drawFlags(void);
+void drawLoading(const char* subtitle, const char* msg);
 void drawStatus(bool withSep);
 void drawTop(bool withSep);
 int maineventloop(
 	const char *subtitle,
-	int (*callback)(sFlag** curr, int key),
-	int (*drawflag)(sFlag*  flag, bool highlight),
-	sFlag* flags,
+	int (*callback)(int* curr, int key),
+	void (*drawflag)(sFlag* flag, int line, const sRow* row, int count, bool highlight),
+	sFlagList* flags,
 	sKey* keys,
 	bool withSep);
 void resetDisplay(bool withSep);
+void resizecurses(void);
 bool scrollcurrent(void);
+void setLoader(int fd, bool (*loader)(void));
 bool setNextItem(int count, bool strict);
 bool setPrevItem(int count, bool strict);
+void touchFlags(void);
 bool yesno(const char *);
 
 